@@ -5,17 +5,21 @@
 
 #include "addr2line.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "base/commandlineflags.h"
 #include "base/logging.h"
+#include "debug_file_finder.h"
 #include "symbol_map.h"
 #include "third_party/abseil/absl/container/node_hash_map.h"
 #include "third_party/abseil/absl/flags/flag.h"
 #include "llvm/DebugInfo/DWARF/DWARFContext.h"
 #include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/FileSystem.h"
 
 ABSL_RETIRED_FLAG(bool, use_legacy_symbolizer, false,
                   "whether to use google3 symbolizer");
@@ -38,6 +42,15 @@ llvm::object::OwningBinary<llvm::object::ObjectFile> GetOwningBinary(
   }
   return std::move(object_owning_binary_or_err.get());
 }
+
+// Returns the split DWARF package (.dwp) of BINARY_NAME if there is one next
+// to it, or "" to let LLVM look for "<file>.dwp" next to the file the DWARF
+// is read from, which differs from BINARY_NAME for separate debug files.
+std::string GetDWPName(const std::string &binary_name) {
+  std::string dwp_name = binary_name + ".dwp";
+  if (!llvm::sys::fs::exists(dwp_name)) return "";
+  return dwp_name;
+}
 }  // namespace
 
 namespace devtools_crosstool_autofdo {
@@ -49,7 +62,7 @@ Addr2line *Addr2line::Create(const std::string &binary_name) {
 Addr2line *Addr2line::CreateWithSampledFunctions(
     const std::string &binary_name,
     const std::map<uint64_t, uint64_t> *sampled_functions) {
-  Addr2line *addr2line = new LLVMAddr2line(binary_name);
+  Addr2line *addr2line = new LLVMAddr2line(binary_name, sampled_functions);
   if (!addr2line->Prepare()) {
     delete addr2line;
     return nullptr;
@@ -58,14 +71,71 @@ Addr2line *Addr2line::CreateWithSampledFunctions(
   }
 }
 
-LLVMAddr2line::LLVMAddr2line(const std::string &binary_name)
-    : Addr2line(binary_name), binary_(GetOwningBinary(binary_name)) {}
+LLVMAddr2line::LLVMAddr2line(
+    const std::string &binary_name,
+    const std::map<uint64_t, uint64_t> *sampled_functions)
+    : Addr2line(binary_name),
+      sampled_functions_(sampled_functions),
+      binary_(GetOwningBinary(FindDebugFile(binary_name))) {}
 
 bool LLVMAddr2line::Prepare() {
   if (!binary_.getBinary()) return false;
-  dwarf_info_ = llvm::DWARFContext::create(*binary_.getBinary());
-  for (auto &unit : dwarf_info_->compile_units()) {
-    unit_map_[unit->getOffset()] = unit.get();
+  // The line tables of a relocatable object tell which section each
+  // sequence is in. The symbol map only keeps the functions of .text.
+  if (binary_.getBinary()->isRelocatableObject()) {
+    for (const llvm::object::SectionRef &section :
+         binary_.getBinary()->sections()) {
+      llvm::Expected<llvm::StringRef> name = section.getName();
+      if (name && *name == ".text") {
+        section_index_ = section.getIndex();
+        break;
+      }
+      if (!name) llvm::consumeError(name.takeError());
+    }
+  }
+  // Units built with -gsplit-dwarf only leave a skeleton here. LLVM loads the
+  // matching unit from the .dwp package or the unit's .dwo file the first
+  // time the skeleton is asked for an inline stack, and keeps it with the
+  // skeleton for later lookups.
+#if LLVM_VERSION_MAJOR >= 13
+  dwarf_info_ = llvm::DWARFContext::create(
+      *binary_.getBinary(), llvm::DWARFContext::ProcessDebugRelocations::Process,
+      nullptr, GetDWPName(binary_name_));
+#else
+  dwarf_info_ = llvm::DWARFContext::create(*binary_.getBinary(), nullptr,
+                                           GetDWPName(binary_name_));
+#endif
+  if (sampled_functions_ == nullptr) {
+    for (auto &unit : dwarf_info_->compile_units()) {
+      unit_map_[unit->getOffset()] = unit.get();
+    }
+    return true;
+  }
+  // Only register the compile units that contain a sampled function. The
+  // DWARFContext parses line tables and DIE trees lazily, so the units that
+  // are never looked up cost nothing beyond their header.
+  const llvm::DWARFDebugAranges *aranges = dwarf_info_->getDebugAranges();
+  for (const auto &addr_size : *sampled_functions_) {
+    uint64_t cu_offset = aranges->findAddress(addr_size.first);
+    if (cu_offset == -1ULL || unit_map_.count(cu_offset)) continue;
+    llvm::DWARFCompileUnit *unit =
+        dwarf_info_->getCompileUnitForOffset(cu_offset);
+    if (unit == nullptr) continue;
+    unit_map_[cu_offset] = unit;
+    // Load the split unit of sampled skeletons up front, so that a missing
+    // .dwo or .dwp is reported once instead of silently yielding empty
+    // inline stacks.
+    if (unit->getDWOId() &&
+        unit->getNonSkeletonUnitDIE().getDwarfUnit() == unit) {
+      LOG(WARNING) << "Cannot load split DWARF unit '"
+                   << llvm::dwarf::toString(
+                          unit->getUnitDIE().find(
+                              {llvm::dwarf::DW_AT_dwo_name,
+                               llvm::dwarf::DW_AT_GNU_dwo_name}),
+                          "")
+                   << "' of '" << binary_name_
+                   << "': no inline stacks for its functions";
+    }
   }
   return true;
 }
@@ -83,7 +153,7 @@ void LLVMAddr2line::GetInlineStack(uint64_t address, SourceStack *stack) const {
   cu_iter->second->getInlinedChainForAddress(address, InlinedChain);
 
   uint32_t row_index = line_table->lookupAddress(
-      {address, llvm::object::SectionedAddress::UndefSection});
+      {address, section_index_});
   uint32_t file = (row_index == -1U ? -1U : line_table->Rows[row_index].File);
   uint32_t line = (row_index == -1U ? 0 : line_table->Rows[row_index].Line);
   uint32_t discriminator =
@@ -92,16 +162,20 @@ void LLVMAddr2line::GetInlineStack(uint64_t address, SourceStack *stack) const {
     const char *function_name =
         FunctionDIE.getSubroutineName(llvm::DINameKind::LinkageName);
     uint32_t start_line = FunctionDIE.getDeclLine();
-    std::string file_name;
-    std::string dir_name;
+    const char *file_name = "";
+    const char *dir_name = "";
     if (line_table->hasFileAtIndex(file)) {
       const auto &entry = line_table->Prologue.getFileNameEntry(file);
       file_name = entry.Name.getAsCString().getValue();
-      if (entry.DirIdx > 0 &&
-          entry.DirIdx <= line_table->Prologue.IncludeDirectories.size())
-        dir_name = line_table->Prologue.IncludeDirectories[entry.DirIdx - 1]
-                       .getAsCString()
-                       .getValue();
+      // Directory 0 is the compilation directory, which is left out. It is
+      // only listed from DWARF 5 on, so the others are numbered from 1
+      // before that.
+      const auto &dirs = line_table->Prologue.IncludeDirectories;
+      const uint64_t dir_index = line_table->Prologue.getVersion() >= 5
+                                     ? entry.DirIdx
+                                     : entry.DirIdx - 1;
+      if (entry.DirIdx > 0 && dir_index < dirs.size())
+        dir_name = dirs[dir_index].getAsCString().getValue();
     }
     stack->push_back(SourceInfo(function_name, dir_name, file_name, start_line,
                                 line, discriminator));
@@ -109,4 +183,60 @@ void LLVMAddr2line::GetInlineStack(uint64_t address, SourceStack *stack) const {
     FunctionDIE.getCallerFrame(file, line, col, discriminator);
   }
 }
+
+uint64_t LLVMAddr2line::GetInlineStackRangeEnd(uint64_t address) const {
+  auto cu_iter =
+      unit_map_.find(dwarf_info_->getDebugAranges()->findAddress(address));
+  if (cu_iter == unit_map_.end())
+    return address + 1;
+  const llvm::DWARFDebugLine::LineTable *line_table =
+      dwarf_info_->getLineTableForUnit(cu_iter->second);
+  if (line_table == nullptr)
+    return address + 1;
+  // The line of the innermost frame holds until the next row of the
+  // sequence, which always ends with an end_sequence row.
+  uint32_t row_index = line_table->lookupAddress(
+      {address, section_index_});
+  if (row_index == -1U || row_index + 1 >= line_table->Rows.size())
+    return address + 1;
+  uint64_t end = line_table->Rows[row_index + 1].Address.Address;
+  // The frames come from the innermost subroutine covering the address.
+  const std::vector<uint64_t> &bounds =
+      GetSubroutineBounds(cu_iter->first, cu_iter->second);
+  auto next = std::upper_bound(bounds.begin(), bounds.end(), address);
+  if (next != bounds.end())
+    end = std::min(end, *next);
+  return std::max(end, address + 1);
+}
+
+const std::vector<uint64_t> &LLVMAddr2line::GetSubroutineBounds(
+    uint32_t cu_offset, llvm::DWARFUnit *unit) const {
+  auto bounds_iter = subroutine_bounds_.find(cu_offset);
+  if (bounds_iter != subroutine_bounds_.end())
+    return bounds_iter->second;
+  std::vector<uint64_t> &bounds = subroutine_bounds_[cu_offset];
+  auto add_ranges = [&bounds](const llvm::DWARFDie &die) {
+    auto ranges = die.getAddressRanges();
+    if (!ranges) {
+      llvm::consumeError(ranges.takeError());
+      return;
+    }
+    for (const llvm::DWARFAddressRange &range : *ranges) {
+      bounds.push_back(range.LowPC);
+      bounds.push_back(range.HighPC);
+    }
+  };
+  add_ranges(unit->getUnitDIE());
+  // With split DWARF, the subroutines are in the split unit.
+  llvm::DWARFUnit *dies_unit =
+      unit->getNonSkeletonUnitDIE(false).getDwarfUnit();
+  for (const llvm::DWARFDebugInfoEntry &entry : dies_unit->dies()) {
+    llvm::DWARFDie die(dies_unit, &entry);
+    if (die.isSubroutineDIE())
+      add_ranges(die);
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+  return bounds;
+}
 }  // namespace devtools_crosstool_autofdo
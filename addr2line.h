@@ -9,6 +9,7 @@
 #include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "base/integral_types.h"
 #include "base/macros.h"
@@ -27,6 +28,9 @@ class Addr2line {
 
   virtual ~Addr2line() {}
 
+  // Creates the symbolizer of BINARY_NAME. If the binary has been stripped of
+  // its debug info, the DWARF is read from its separate debug file instead
+  // (see FindDebugFile).
   static Addr2line *Create(const std::string &binary_name);
 
   static Addr2line *CreateWithSampledFunctions(
@@ -40,6 +44,11 @@ class Addr2line {
   // Stores the inline stack of ADDR in STACK.
   virtual void GetInlineStack(uint64_t addr, SourceStack *stack) const = 0;
 
+  // Returns the end of the address range that starts at ADDR and over which
+  // GetInlineStack returns the same stack as for ADDR. The range may be cut
+  // short, but it holds at least ADDR.
+  virtual uint64_t GetInlineStackRangeEnd(uint64_t addr) const = 0;
+
  protected:
   std::string binary_name_;
 
@@ -50,15 +59,35 @@ class Addr2line {
 #if defined(HAVE_LLVM)
 class LLVMAddr2line : public Addr2line {
  public:
-  explicit LLVMAddr2line(const std::string &binary_name);
+  explicit LLVMAddr2line(const std::string &binary_name)
+      : LLVMAddr2line(binary_name, nullptr) {}
+  LLVMAddr2line(const std::string &binary_name,
+                const std::map<uint64_t, uint64_t> *sampled_functions);
   bool Prepare() override;
   void GetInlineStack(uint64_t address, SourceStack *stack) const override;
+  uint64_t GetInlineStackRangeEnd(uint64_t address) const override;
 
  private:
-  // map from cu_offset to the CompileUnit.
+  // Returns the sorted start and end addresses of the unit and of all its
+  // subprograms and inlined subroutines, where the inlined chain of an
+  // address may change. Computed on first use.
+  const std::vector<uint64_t> &GetSubroutineBounds(uint32_t cu_offset,
+                                                   llvm::DWARFUnit *unit) const;
+
+  // map from cu_offset to the CompileUnit. When sampled_functions_ is set,
+  // only the compile units covering a sampled function are registered, so
+  // the line tables and DIEs of all other units are never parsed.
   std::map<uint32_t, llvm::DWARFUnit *> unit_map_;
+  // Map from cu_offset to the bounds returned by GetSubroutineBounds.
+  mutable std::map<uint32_t, std::vector<uint64_t>> subroutine_bounds_;
+  // Map from start address to size of the sampled functions, or nullptr if
+  // every compile unit should be loaded. Not owned.
+  const std::map<uint64_t, uint64_t> *sampled_functions_;
   llvm::object::OwningBinary<llvm::object::ObjectFile> binary_;
   std::unique_ptr<llvm::DWARFContext> dwarf_info_;
+  // Section that the addresses are relative to in a relocatable object,
+  // such as a kernel module: its .text section.
+  uint64_t section_index_ = llvm::object::SectionedAddress::UndefSection;
 };
 #else
 class AddressQuery;
@@ -74,6 +103,7 @@ class Google3Addr2line : public Addr2line {
   virtual ~Google3Addr2line();
   virtual bool Prepare();
   virtual void GetInlineStack(uint64_t address, SourceStack *stack) const;
+  virtual uint64_t GetInlineStackRangeEnd(uint64_t address) const;
 
  private:
   AddressToLineMap *line_map_;
@@ -0,0 +1,144 @@
+// These tests check that the symbolizer reads the same inline stacks from
+// DWARF 5 debug info as from DWARF 4. They are built for both LLVMAddr2line
+// and Google3Addr2line.
+//
+// testdata/dwarf5.binary and testdata/dwarf4.binary are the same program,
+// built with -O2 -g -gdwarf-5 and -gdwarf-4 respectively. It is made of a C
+// compilation unit from GCC, which uses .debug_line_str and .debug_rnglists,
+// and a Rust one from LLVM, which also refers to its strings, addresses and
+// range lists by index.
+
+#include "addr2line.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "source_info.h"
+#include "symbol_map.h"
+#include "gtest/gtest.h"
+#include "third_party/abseil/absl/strings/str_cat.h"
+
+#define FLAGS_test_srcdir std::string(testing::UnitTest::GetInstance()->original_working_dir())
+
+namespace {
+
+using ::devtools_crosstool_autofdo::Addr2line;
+using ::devtools_crosstool_autofdo::SourceInfo;
+using ::devtools_crosstool_autofdo::SourceStack;
+using ::devtools_crosstool_autofdo::SymbolMap;
+
+const char kTestDataDir[] = "/testdata/";
+
+// Returns a dump of the inline stack of ADDRESS, innermost frame first.
+std::string DumpInlineStack(const Addr2line &addr2line, uint64_t address) {
+  SourceStack stack;
+  addr2line.GetInlineStack(address, &stack);
+  std::string dump;
+  for (const SourceInfo &info : stack) {
+    absl::StrAppend(&dump, info.func_name ? info.func_name : "??", " ",
+                    info.dir_name, "/", info.file_name, ":", info.line, ".",
+                    info.discriminator, " start ", info.start_line, "; ");
+  }
+  return dump;
+}
+
+TEST(Addr2lineTest, Dwarf5MatchesDwarf4) {
+  const std::string dwarf4 = FLAGS_test_srcdir + kTestDataDir + "dwarf4.binary";
+  const std::string dwarf5 = FLAGS_test_srcdir + kTestDataDir + "dwarf5.binary";
+  std::unique_ptr<Addr2line> addr2line4(Addr2line::Create(dwarf4));
+  std::unique_ptr<Addr2line> addr2line5(Addr2line::Create(dwarf5));
+  ASSERT_NE(addr2line4, nullptr);
+  ASSERT_NE(addr2line5, nullptr);
+
+  // Both binaries have their code at the same addresses.
+  SymbolMap symbol_map(dwarf5);
+  int num_addresses = 0, num_inlined = 0;
+  bool found_rust = false;
+  for (const auto &name_addr : symbol_map.GetNameAddrMap()) {
+    const std::string *name;
+    uint64_t start_addr, end_addr;
+    if (!symbol_map.GetSymbolInfoByAddr(name_addr.second, &name, &start_addr,
+                                        &end_addr)) {
+      continue;
+    }
+    for (uint64_t address = start_addr; address < end_addr; ++address) {
+      const std::string stack = DumpInlineStack(*addr2line5, address);
+      EXPECT_EQ(DumpInlineStack(*addr2line4, address), stack)
+          << "at address 0x" << std::hex << address;
+      if (stack.empty()) continue;
+      ++num_addresses;
+      SourceStack frames;
+      addr2line5->GetInlineStack(address, &frames);
+      if (frames.size() > 1) ++num_inlined;
+      if (frames.back().file_name == "lib.rs") found_rust = true;
+    }
+  }
+  EXPECT_GT(num_addresses, 0);
+  EXPECT_GT(num_inlined, 0);
+  EXPECT_TRUE(found_rust);
+}
+
+TEST(Addr2lineTest, Dwarf5InlineStack) {
+  std::unique_ptr<Addr2line> addr2line(Addr2line::Create(
+      FLAGS_test_srcdir + kTestDataDir + "dwarf5.binary"));
+  ASSERT_NE(addr2line, nullptr);
+  SymbolMap symbol_map(FLAGS_test_srcdir + kTestDataDir + "dwarf5.binary");
+  const std::string *name;
+  uint64_t start_addr, end_addr;
+  ASSERT_TRUE(symbol_map.GetSymbolInfoByAddr(
+      symbol_map.GetNameAddrMap().at("work"), &name, &start_addr,
+      &end_addr));
+
+  // The inlined scale() and combine() show up within work().
+  bool found_scale = false;
+  for (uint64_t address = start_addr; address < end_addr; ++address) {
+    SourceStack stack;
+    addr2line->GetInlineStack(address, &stack);
+    if (stack.empty()) continue;
+    EXPECT_STREQ("work", stack.back().func_name);
+    EXPECT_EQ("dwarf5.c", stack.back().file_name);
+    if (stack.size() == 3) {
+      EXPECT_STREQ("scale", stack[0].func_name);
+      EXPECT_STREQ("combine", stack[1].func_name);
+      found_scale = true;
+    }
+  }
+  EXPECT_TRUE(found_scale);
+}
+
+TEST(Addr2lineTest, InlineStackRangeEnd) {
+  for (const char *binary : {"dwarf4.binary", "dwarf5.binary"}) {
+    const std::string path = FLAGS_test_srcdir + kTestDataDir + binary;
+    std::unique_ptr<Addr2line> addr2line(Addr2line::Create(path));
+    ASSERT_NE(addr2line, nullptr);
+    SymbolMap symbol_map(path);
+    int num_runs = 0, num_addresses = 0;
+    for (const auto &name_addr : symbol_map.GetNameAddrMap()) {
+      const std::string *name;
+      uint64_t start_addr, end_addr;
+      if (!symbol_map.GetSymbolInfoByAddr(name_addr.second, &name,
+                                          &start_addr, &end_addr)) {
+        continue;
+      }
+      // Every address of a run has the stack of its first address.
+      for (uint64_t address = start_addr; address < end_addr;) {
+        const uint64_t run_end = addr2line->GetInlineStackRangeEnd(address);
+        ASSERT_GT(run_end, address);
+        const std::string stack = DumpInlineStack(*addr2line, address);
+        for (uint64_t next = address + 1; next < run_end && next < end_addr;
+             ++next) {
+          EXPECT_EQ(DumpInlineStack(*addr2line, next), stack)
+              << binary << " at address 0x" << std::hex << next;
+        }
+        address = run_end;
+        ++num_runs;
+      }
+      num_addresses += end_addr - start_addr;
+    }
+    // Runs span more than one address.
+    EXPECT_LT(num_runs, num_addresses / 2) << binary;
+  }
+}
+}  // namespace
@@ -0,0 +1,39 @@
+// Precomputes the symbol map skeleton of a binary, so that the profiles
+// converted for it later do not all read its symbol tables again.
+
+#include <string>
+
+#include "base/commandlineflags.h"
+#include "base/logging.h"
+#include "symbol_map.h"
+#include "symbol_map_skeleton.h"
+#include "third_party/abseil/absl/flags/flag.h"
+#include "third_party/abseil/absl/flags/parse.h"
+#include "third_party/abseil/absl/flags/usage.h"
+#include "util/symbolize/elf_reader.h"
+
+ABSL_FLAG(std::string, binary, "a.out", "Binary file name");
+ABSL_FLAG(std::string, out_dir, ".",
+          "Directory to write the skeleton to, as <build-id>.skel. Pass it "
+          "as --symbol_skeleton_dir when converting profiles of the binary.");
+
+int main(int argc, char **argv) {
+  absl::SetProgramUsageMessage(
+      "Usage: create_symbol_skeleton --binary=<binary> --out_dir=<dir>");
+  absl::ParseCommandLine(argc, argv);
+
+  const std::string binary = absl::GetFlag(FLAGS_binary);
+  const std::string build_id =
+      devtools_crosstool_autofdo::ElfReader(binary).GetBuildId();
+  if (build_id.empty()) {
+    LOG(ERROR) << binary << " has no build-id";
+    return 1;
+  }
+  devtools_crosstool_autofdo::SymbolMap symbol_map(binary);
+  const std::string path =
+      absl::GetFlag(FLAGS_out_dir) + "/" +
+      devtools_crosstool_autofdo::SymbolMapSkeleton::FileName(build_id);
+  if (!symbol_map.WriteSkeleton(path)) return 1;
+  LOG(INFO) << "Wrote " << path;
+  return 0;
+}
@@ -0,0 +1,132 @@
+// Locates the separate debug info file of a stripped binary.
+
+#include "debug_file_finder.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base/logging.h"
+#include "symbolize/elf_reader.h"
+#include "third_party/abseil/absl/flags/flag.h"
+#include "third_party/abseil/absl/strings/str_cat.h"
+
+ABSL_FLAG(std::vector<std::string>, debug_file_directory, {"/usr/lib/debug"},
+          "Comma-separated list of directories searched for the separate "
+          "debug info file of a stripped binary, by build-id and by "
+          ".gnu_debuglink");
+
+namespace {
+// Returns the directory part of PATH, without the trailing slash, or "."
+// if PATH has none.
+std::string DirName(const std::string &path) {
+  std::string::size_type pos = path.rfind('/');
+  if (pos == std::string::npos) return ".";
+  if (pos == 0) return "/";
+  return path.substr(0, pos);
+}
+
+// Reads the .gnu_debuglink section of ELF: a NUL-terminated file name,
+// padded to 4 bytes, followed by the CRC32 of that file.
+bool GetDebuglink(devtools_crosstool_autofdo::ElfReader *elf,
+                  std::string *debuglink, uint32_t *crc) {
+  size_t size;
+  const char *data = elf->GetSectionByName(".gnu_debuglink", &size);
+  if (data == nullptr) return false;
+  size_t name_len = strnlen(data, size);
+  size_t crc_offset = (name_len + 4) & ~static_cast<size_t>(3);
+  if (name_len == 0 || crc_offset + sizeof(*crc) > size) return false;
+  debuglink->assign(data, name_len);
+  memcpy(crc, data + crc_offset, sizeof(*crc));
+  return true;
+}
+}  // namespace
+
+namespace devtools_crosstool_autofdo {
+
+std::vector<std::string> GetDebugFileCandidates(
+    const std::string &binary_name, const std::string &build_id,
+    const std::string &debuglink,
+    const std::vector<std::string> &debug_dirs) {
+  std::vector<std::string> candidates;
+  if (build_id.size() > 2) {
+    for (const std::string &dir : debug_dirs) {
+      candidates.push_back(absl::StrCat(dir, "/.build-id/",
+                                        build_id.substr(0, 2), "/",
+                                        build_id.substr(2), ".debug"));
+    }
+  }
+  if (!debuglink.empty()) {
+    const std::string binary_dir = DirName(binary_name);
+    candidates.push_back(absl::StrCat(binary_dir, "/", debuglink));
+    candidates.push_back(absl::StrCat(binary_dir, "/.debug/", debuglink));
+    for (const std::string &dir : debug_dirs) {
+      if (binary_dir[0] == '/') {
+        candidates.push_back(absl::StrCat(dir, binary_dir, "/", debuglink));
+      } else {
+        candidates.push_back(absl::StrCat(dir, "/", binary_dir, "/",
+                                          debuglink));
+      }
+    }
+  }
+  return candidates;
+}
+
+bool GetDebuglinkCrc(const std::string &path, uint32_t *crc) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  uLong value = crc32(0L, Z_NULL, 0);
+  std::vector<Bytef> buffer(1 << 16);
+  ssize_t n;
+  while ((n = read(fd, buffer.data(), buffer.size())) > 0)
+    value = crc32(value, buffer.data(), n);
+  close(fd);
+  if (n < 0) return false;
+  *crc = static_cast<uint32_t>(value);
+  return true;
+}
+
+std::string FindDebugFile(const std::string &binary_name) {
+  if (ElfReader::IsNonDebugStrippedELFBinary(binary_name)) return binary_name;
+
+  ElfReader elf(binary_name);
+  if (!elf.IsElf32File() && !elf.IsElf64File()) return binary_name;
+  const std::string build_id = elf.GetBuildId();
+  std::string debuglink;
+  uint32_t debuglink_crc = 0;
+  if (!GetDebuglink(&elf, &debuglink, &debuglink_crc)) debuglink.clear();
+  if (build_id.empty() && debuglink.empty()) return binary_name;
+
+  const std::vector<std::string> candidates = GetDebugFileCandidates(
+      binary_name, build_id, debuglink,
+      absl::GetFlag(FLAGS_debug_file_directory));
+  for (const std::string &candidate : candidates) {
+    if (candidate == binary_name ||
+        !ElfReader::IsNonDebugStrippedELFBinary(candidate)) {
+      continue;
+    }
+    // A build-id match identifies the debug file on its own. Files found
+    // through the debuglink name only are accepted if their CRC matches.
+    if (!build_id.empty() && ElfReader(candidate).GetBuildId() == build_id) {
+      LOG(INFO) << "Using debug file '" << candidate << "' for '"
+                << binary_name << "' (build-id " << build_id << ")";
+      return candidate;
+    }
+    uint32_t crc;
+    if (!debuglink.empty() && GetDebuglinkCrc(candidate, &crc) &&
+        crc == debuglink_crc) {
+      LOG(INFO) << "Using debug file '" << candidate << "' for '"
+                << binary_name << "' (.gnu_debuglink)";
+      return candidate;
+    }
+  }
+  LOG(WARNING) << "'" << binary_name << "' has no debug info and no "
+               << "matching separate debug file was found";
+  return binary_name;
+}
+}  // namespace devtools_crosstool_autofdo
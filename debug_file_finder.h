@@ -0,0 +1,37 @@
+// Locates the separate debug info file of a stripped binary.
+
+#ifndef AUTOFDO_DEBUG_FILE_FINDER_H_
+#define AUTOFDO_DEBUG_FILE_FINDER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace devtools_crosstool_autofdo {
+
+// Returns the path of the file holding the DWARF of BINARY_NAME. This is
+// BINARY_NAME itself unless it has been stripped of its debug sections, in
+// which case the debug file is looked up through the binary's build-id note
+// and then its .gnu_debuglink section, under the directories listed in
+// --debug_file_directory. Falls back to BINARY_NAME if nothing matches.
+std::string FindDebugFile(const std::string &binary_name);
+
+// Returns the paths at which the debug file of BINARY_NAME may live, in
+// lookup order, following the layout used by gdb:
+//   <debug_dir>/.build-id/<id[0:2]>/<id[2:]>.debug
+//   <binary_dir>/<debuglink>
+//   <binary_dir>/.debug/<debuglink>
+//   <debug_dir>/<binary_dir>/<debuglink>
+// BUILD_ID is the hex string of the build-id note and DEBUGLINK the file
+// name stored in .gnu_debuglink; either may be empty.
+std::vector<std::string> GetDebugFileCandidates(
+    const std::string &binary_name, const std::string &build_id,
+    const std::string &debuglink,
+    const std::vector<std::string> &debug_dirs);
+
+// Returns the CRC32 of the contents of PATH as used by .gnu_debuglink, or
+// false if the file cannot be read.
+bool GetDebuglinkCrc(const std::string &path, uint32_t *crc);
+}  // namespace devtools_crosstool_autofdo
+
+#endif  // AUTOFDO_DEBUG_FILE_FINDER_H_
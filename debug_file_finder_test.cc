@@ -0,0 +1,71 @@
+// These tests check that the separate debug file of a binary is looked up
+// at the expected places and verified.
+
+#include "debug_file_finder.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#define FLAGS_test_tmpdir std::string(testing::UnitTest::GetInstance()->original_working_dir())
+
+#define FLAGS_test_srcdir std::string(testing::UnitTest::GetInstance()->original_working_dir())
+
+namespace {
+
+using ::devtools_crosstool_autofdo::FindDebugFile;
+using ::devtools_crosstool_autofdo::GetDebugFileCandidates;
+using ::devtools_crosstool_autofdo::GetDebuglinkCrc;
+using ::testing::ElementsAre;
+
+const char kTestDataDir[] = "/testdata/";
+
+TEST(DebugFileFinderTest, CandidatesFromBuildIdAndDebuglink) {
+  EXPECT_THAT(
+      GetDebugFileCandidates("/opt/bin/server", "abcdef0123", "server.debug",
+                             {"/usr/lib/debug", "/data/debug"}),
+      ElementsAre("/usr/lib/debug/.build-id/ab/cdef0123.debug",
+                  "/data/debug/.build-id/ab/cdef0123.debug",
+                  "/opt/bin/server.debug", "/opt/bin/.debug/server.debug",
+                  "/usr/lib/debug/opt/bin/server.debug",
+                  "/data/debug/opt/bin/server.debug"));
+}
+
+TEST(DebugFileFinderTest, CandidatesWithoutBuildId) {
+  EXPECT_THAT(GetDebugFileCandidates("server", "", "server.debug",
+                                     {"/usr/lib/debug"}),
+              ElementsAre("./server.debug", "./.debug/server.debug",
+                          "/usr/lib/debug/./server.debug"));
+  EXPECT_TRUE(
+      GetDebugFileCandidates("server", "", "", {"/usr/lib/debug"}).empty());
+}
+
+TEST(DebugFileFinderTest, DebuglinkCrc) {
+  const std::string path = FLAGS_test_tmpdir + "/debuglink_crc.txt";
+  {
+    std::ofstream out(path);
+    out << "123456789";
+  }
+  uint32_t crc = 0;
+  ASSERT_TRUE(GetDebuglinkCrc(path, &crc));
+  EXPECT_EQ(crc, 0xcbf43926);
+  EXPECT_FALSE(GetDebuglinkCrc(path + ".missing", &crc));
+}
+
+TEST(DebugFileFinderTest, BinaryWithDebugInfo) {
+  const std::string binary =
+      FLAGS_test_srcdir + kTestDataDir + "llvm_function_samples.binary";
+  EXPECT_EQ(FindDebugFile(binary), binary);
+}
+
+TEST(DebugFileFinderTest, NoDebugFileFound) {
+  // Has a build-id but neither debug info nor a debug file to go with it.
+  const std::string binary =
+      FLAGS_test_srcdir + kTestDataDir + "jump_table_test.binary";
+  EXPECT_EQ(FindDebugFile(binary), binary);
+}
+}  // namespace
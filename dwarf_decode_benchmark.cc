@@ -0,0 +1,206 @@
+// Measures how fast the DWARF reader used by the symbolizer without LLVM
+// decodes the line programs and the DIEs of binaries, e.g.
+//
+//   dwarf_decode_benchmark --iterations=1000 testdata/test.binary
+//
+// Both mostly decode LEB128 numbers. Each binary's .debug_line and
+// .debug_info are decoded ITERATIONS times with handlers that do nothing
+// but count, and the throughput of the best iteration is reported.
+// .debug_info is decoded once more skipping the subtrees of the DIEs that
+// cannot hold code.
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "base/logging.h"
+#include "symbolize/bytereader.h"
+#include "symbolize/dwarf2reader.h"
+#include "symbolize/elf_reader.h"
+#include "third_party/abseil/absl/flags/flag.h"
+#include "third_party/abseil/absl/flags/parse.h"
+
+ABSL_FLAG(int32_t, iterations, 100,
+          "Number of times each section is decoded.");
+
+namespace {
+
+using devtools_crosstool_autofdo::AbbrevTableCache;
+using devtools_crosstool_autofdo::AttributeList;
+using devtools_crosstool_autofdo::ByteReader;
+using devtools_crosstool_autofdo::CompilationUnit;
+using devtools_crosstool_autofdo::Dwarf2Handler;
+using devtools_crosstool_autofdo::DwarfTag;
+using devtools_crosstool_autofdo::ElfReader;
+using devtools_crosstool_autofdo::ENDIANNESS_LITTLE;
+using devtools_crosstool_autofdo::LineInfo;
+using devtools_crosstool_autofdo::LineInfoHandler;
+using devtools_crosstool_autofdo::SectionMap;
+
+class CountingLineHandler : public LineInfoHandler {
+ public:
+  void AddLine(uint64 address, uint32 file_num, uint32 line_num,
+               uint32 column_num, uint32 discriminator,
+               bool end_sequence) override {
+    ++num_rows;
+  }
+
+  uint64_t num_rows = 0;
+};
+
+// Walks every DIE and every attribute of the compilation units.
+class CountingDieHandler : public Dwarf2Handler {
+ public:
+  bool StartCompilationUnit(uint64 offset, uint8 address_size,
+                            uint8 offset_size, uint64 cu_length,
+                            uint8 dwarf_version) override {
+    return true;
+  }
+  bool StartDIE(uint64 offset, DwarfTag tag,
+                const AttributeList &attrs) override {
+    ++num_dies;
+    return true;
+  }
+
+  uint64_t num_dies = 0;
+};
+
+// Walks the DIEs of the compilation units, skipping the subtrees of those
+// that cannot hold code, such as types, the way a symbolizer does.
+class SkippingDieHandler : public CountingDieHandler {
+ public:
+  bool WantChildren(uint64 offset, DwarfTag tag) override {
+    switch (tag) {
+      case devtools_crosstool_autofdo::DW_TAG_compile_unit:
+      case devtools_crosstool_autofdo::DW_TAG_namespace:
+      case devtools_crosstool_autofdo::DW_TAG_subprogram:
+      case devtools_crosstool_autofdo::DW_TAG_inlined_subroutine:
+      case devtools_crosstool_autofdo::DW_TAG_lexical_block:
+        return true;
+      default:
+        return false;
+    }
+  }
+};
+
+// Decodes all the line programs in .debug_line, whose DWARF 5 file names
+// may be in .debug_line_str at LINE_STR. Returns the number of rows.
+uint64_t DecodeLines(const char *data, size_t size, const char *line_str,
+                     size_t line_str_size, ByteReader *reader) {
+  CountingLineHandler handler;
+  size_t pos = 0;
+  while (pos < size) {
+    LineInfo line(data + pos, size - pos, line_str, line_str_size, reader,
+                  &handler);
+    uint64 read = line.Start();
+    if (line.malformed() || read == 0) break;
+    pos += read;
+  }
+  return handler.num_rows;
+}
+
+// Decodes all the compilation units in .debug_info with a HANDLER. Returns
+// the number of DIEs it was given.
+template <typename Handler>
+uint64_t DecodeDies(const std::string &binary, const SectionMap &sections,
+                    size_t size, ByteReader *reader) {
+  Handler handler;
+  AbbrevTableCache abbrev_cache;
+  uint64 offset = 0;
+  while (offset < size) {
+    CompilationUnit unit(binary, sections, offset, reader, &handler);
+    unit.set_abbrev_cache(&abbrev_cache);
+    uint64 read = unit.Start();
+    if (unit.malformed() || read == 0) break;
+    offset += read;
+  }
+  return handler.num_dies;
+}
+
+// Runs DECODE the requested number of times and prints the throughput of
+// its fastest run over SIZE bytes, which produced ITEMS.
+template <typename Decode>
+void Measure(const char *what, const char *items, size_t size,
+             const Decode &decode) {
+  double best = 0;
+  uint64_t count = 0;
+  for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+    auto start = std::chrono::steady_clock::now();
+    count = decode();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (i == 0 || elapsed.count() < best) best = elapsed.count();
+  }
+  if (best <= 0) return;
+  printf("  %-12s %10zu bytes %8llu %-5s %8.1f MB/s %8.2f ns/%s\n", what, size,
+         static_cast<unsigned long long>(count), items, size / best / 1e6,
+         count ? best * 1e9 / count : 0.0, items);
+}
+
+void Benchmark(const std::string &binary) {
+  ElfReader elf(binary);
+  ByteReader reader(ENDIANNESS_LITTLE);
+  if (elf.IsElf32File()) {
+    reader.SetAddressSize(4);
+  } else if (elf.IsElf64File()) {
+    reader.SetAddressSize(8);
+  } else {
+    LOG(ERROR) << "'" << binary << "' is not an ELF file";
+    return;
+  }
+  const char *section_names[] = {
+      ".debug_abbrev",       ".debug_info", ".debug_line", ".debug_line_str",
+      ".debug_str",          ".debug_addr", ".debug_rnglists",
+      ".debug_str_offsets"};
+  elf.DecompressSections(
+      vector<string>(std::begin(section_names), std::end(section_names)));
+  SectionMap sections;
+  for (const char *section_name : section_names) {
+    size_t size;
+    const char *data = elf.GetSectionByName(section_name, &size);
+    if (data != NULL) sections[section_name] = std::make_pair(data, size);
+  }
+
+  printf("%s\n", binary.c_str());
+  auto line = sections.find(".debug_line");
+  if (line != sections.end()) {
+    auto line_str = sections.find(".debug_line_str");
+    const char *line_str_data = NULL;
+    size_t line_str_size = 0;
+    if (line_str != sections.end()) {
+      line_str_data = line_str->second.first;
+      line_str_size = line_str->second.second;
+    }
+    Measure(".debug_line", "row", line->second.second, [&] {
+      return DecodeLines(line->second.first, line->second.second,
+                         line_str_data, line_str_size, &reader);
+    });
+  }
+  auto info = sections.find(".debug_info");
+  if (info != sections.end() && sections.count(".debug_abbrev")) {
+    Measure(".debug_info", "DIE", info->second.second, [&] {
+      return DecodeDies<CountingDieHandler>(binary, sections,
+                                            info->second.second, &reader);
+    });
+    Measure("  skipping", "DIE", info->second.second, [&] {
+      return DecodeDies<SkippingDieHandler>(binary, sections,
+                                            info->second.second, &reader);
+    });
+  }
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::vector<char *> binaries = absl::ParseCommandLine(argc, argv);
+  if (binaries.size() < 2) {
+    fprintf(stderr, "Usage: %s [--iterations=N] binary...\n", argv[0]);
+    return 1;
+  }
+  for (size_t i = 1; i < binaries.size(); ++i) Benchmark(binaries[i]);
+  return 0;
+}
@@ -0,0 +1,124 @@
+// Class to represent a map stored as a sorted vector of (key, value) pairs.
+
+#ifndef AUTOFDO_FLAT_MAP_H_
+#define AUTOFDO_FLAT_MAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "base/logging.h"
+
+namespace devtools_crosstool_autofdo {
+
+// A map from KEY to VALUE kept as one contiguous vector sorted by key, for
+// the small maps of profile counts that are filled once, then iterated in
+// order by the writers. Keys that are added in increasing order are
+// appended. The others are inserted in place, which moves all the entries
+// after them, so a map filled in random order takes quadratic time. That is
+// fine for the maps of one function's positions or one call's targets, which
+// are small and mostly filled in order; see SymbolMap::AddSourceCount for
+// measured sizes. Lookups are binary searches.
+//
+// Unlike std::map, adding an entry invalidates iterators and references to
+// the other entries, and the keys of the entries must not be modified
+// through iterators.
+template <typename Key, typename Value>
+class FlatMap {
+ public:
+  typedef Key key_type;
+  typedef Value mapped_type;
+  typedef std::pair<Key, Value> value_type;
+  typedef typename std::vector<value_type>::iterator iterator;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+  FlatMap() {}
+
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+  void clear() { entries_.clear(); }
+
+  iterator find(const Key &key) {
+    iterator iter = LowerBound(key);
+    return iter != entries_.end() && !(key < iter->first) ? iter
+                                                          : entries_.end();
+  }
+  const_iterator find(const Key &key) const {
+    return const_cast<FlatMap *>(this)->find(key);
+  }
+
+  size_t count(const Key &key) const { return find(key) != end() ? 1 : 0; }
+
+  Value &at(const Key &key) {
+    iterator iter = find(key);
+    CHECK(iter != entries_.end());
+    return iter->second;
+  }
+  const Value &at(const Key &key) const {
+    return const_cast<FlatMap *>(this)->at(key);
+  }
+
+  // Returns the value of KEY, adding it with a default value if needed.
+  Value &operator[](const Key &key) {
+    if (entries_.empty() || entries_.back().first < key) {
+      entries_.emplace_back(key, Value());
+      return entries_.back().second;
+    }
+    iterator iter = LowerBound(key);
+    if (key < iter->first) {
+      iter = entries_.emplace(iter, key, Value());
+    }
+    return iter->second;
+  }
+
+  // Adds the entries of OTHER to this map.
+  // The values of the keys in both maps are combined with
+  // COMBINE(Value *value, const Value &other_value). Both maps are walked
+  // once, in order.
+  template <typename Combine>
+  void Merge(const FlatMap &other, Combine combine) {
+    if (other.empty()) return;
+    if (entries_.empty() || entries_.back().first < other.entries_[0].first) {
+      entries_.insert(entries_.end(), other.entries_.begin(),
+                      other.entries_.end());
+      return;
+    }
+    std::vector<value_type> merged;
+    merged.reserve(entries_.size() + other.entries_.size());
+    iterator iter = entries_.begin();
+    for (const value_type &entry : other.entries_) {
+      for (; iter != entries_.end() && iter->first < entry.first; ++iter) {
+        merged.push_back(std::move(*iter));
+      }
+      if (iter != entries_.end() && !(entry.first < iter->first)) {
+        merged.push_back(std::move(*iter));
+        combine(&merged.back().second, entry.second);
+        ++iter;
+      } else {
+        merged.push_back(entry);
+      }
+    }
+    std::move(iter, entries_.end(), std::back_inserter(merged));
+    entries_.swap(merged);
+  }
+
+ private:
+  iterator LowerBound(const Key &key) {
+    return std::lower_bound(
+        entries_.begin(), entries_.end(), key,
+        [](const value_type &entry, const Key &key) {
+          return entry.first < key;
+        });
+  }
+
+  std::vector<value_type> entries_;
+};
+}  // namespace devtools_crosstool_autofdo
+
+#endif  // AUTOFDO_FLAT_MAP_H_
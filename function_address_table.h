@@ -0,0 +1,119 @@
+// Class to represent an immutable, sorted table of function address ranges.
+
+#ifndef AUTOFDO_FUNCTION_ADDRESS_TABLE_H_
+#define AUTOFDO_FUNCTION_ADDRESS_TABLE_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+
+namespace devtools_crosstool_autofdo {
+
+// Maps addresses to the function containing them. Built once from an
+// address-ordered map of (start -> (name, size)) and stored as parallel
+// arrays, so that lookups touch only the contiguous start array instead of
+// chasing std::map nodes.
+class FunctionAddressTable {
+ public:
+  // Returned by lookups that do not resolve to any function.
+  static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+  FunctionAddressTable() {}
+
+  // Builds the table from SYMBOLS, which maps start address to the pair of
+  // name and size. The names are referenced, not copied, so SYMBOLS must
+  // outlive the table.
+  explicit FunctionAddressTable(
+      const std::map<uint64_t, std::pair<std::string, uint64_t>> &symbols) {
+    starts_.reserve(symbols.size());
+    ends_.reserve(symbols.size());
+    names_.reserve(symbols.size());
+    for (const auto &addr_symbol : symbols) {
+      starts_.push_back(addr_symbol.first);
+      ends_.push_back(addr_symbol.first + addr_symbol.second.second);
+      names_.push_back(&addr_symbol.second.first);
+    }
+  }
+
+  FunctionAddressTable(FunctionAddressTable &&) = default;
+  FunctionAddressTable &operator=(FunctionAddressTable &&) = default;
+
+  size_t size() const { return starts_.size(); }
+  uint64_t start(size_t i) const { return starts_[i]; }
+  uint64_t end(size_t i) const { return ends_[i]; }
+  const std::string &name(size_t i) const { return *names_[i]; }
+
+  // Returns the index of the function whose [start, end) contains ADDR, or
+  // kNotFound.
+  size_t Find(uint64_t addr) const {
+    size_t i = FindFloor(addr);
+    if (i == kNotFound || addr >= ends_[i]) return kNotFound;
+    return i;
+  }
+
+  // Returns the index of the function starting exactly at ADDR, or kNotFound.
+  size_t FindStart(uint64_t addr) const {
+    size_t i = FindFloor(addr);
+    if (i == kNotFound || starts_[i] != addr) return kNotFound;
+    return i;
+  }
+
+  // Resolves a non-decreasing stream of addresses with a single forward scan
+  // over the table, instead of one binary search per address.
+  class SortedLookup {
+   public:
+    explicit SortedLookup(const FunctionAddressTable &table)
+        : table_(table), next_(0) {}
+
+    // Same as FunctionAddressTable::Find. ADDR must not be smaller than the
+    // address passed to the previous call.
+    size_t Find(uint64_t addr) {
+      size_t i = FindFloor(addr);
+      if (i == kNotFound || addr >= table_.ends_[i]) return kNotFound;
+      return i;
+    }
+
+    // Returns the index of the last function starting at or before ADDR, or
+    // kNotFound. Same ordering requirement as Find.
+    size_t FindFloor(uint64_t addr) {
+      const std::vector<uint64_t> &starts = table_.starts_;
+      while (next_ < starts.size() && starts[next_] <= addr) ++next_;
+      return next_ == 0 ? kNotFound : next_ - 1;
+    }
+
+   private:
+    const FunctionAddressTable &table_;
+    // Index of the first function starting after the last looked up address.
+    size_t next_;
+  };
+
+ private:
+  // Returns the index of the last function starting at or before ADDR, or
+  // kNotFound. The loop body has no data-dependent branch, so the compiler
+  // can lower the comparison to a conditional move.
+  size_t FindFloor(uint64_t addr) const {
+    size_t n = starts_.size();
+    if (n == 0 || addr < starts_[0]) return kNotFound;
+    const uint64_t *base = starts_.data();
+    while (n > 1) {
+      size_t half = n / 2;
+      base = (base[half] <= addr) ? base + half : base;
+      n -= half;
+    }
+    return base - starts_.data();
+  }
+
+  std::vector<uint64_t> starts_;
+  std::vector<uint64_t> ends_;
+  std::vector<const std::string *> names_;
+
+  DISALLOW_COPY_AND_ASSIGN(FunctionAddressTable);
+};
+}  // namespace devtools_crosstool_autofdo
+
+#endif  // AUTOFDO_FUNCTION_ADDRESS_TABLE_H_
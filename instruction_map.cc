@@ -7,32 +7,77 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 #include "addr2line.h"
 #include "symbol_map.h"
 
 namespace devtools_crosstool_autofdo {
-InstructionMap::~InstructionMap() {
-  for (const auto &addr_info : inst_map_) {
-    delete addr_info.second;
-  }
-}
-
 void InstructionMap::BuildPerFunctionInstructionMap(const std::string &name,
                                                     uint64_t start_addr,
                                                     uint64_t end_addr) {
-  if (start_addr >= end_addr) {
-    return;
+  Reset(start_addr, end_addr);
+  AddInstructions(name, start_addr, end_addr);
+}
+
+void InstructionMap::BuildSparsePerFunctionInstructionMap(
+    const std::string &name, uint64_t start_addr, uint64_t end_addr,
+    std::vector<std::pair<uint64_t, uint64_t>> ranges) {
+  Reset(start_addr, end_addr);
+  std::sort(ranges.begin(), ranges.end());
+  // Ranges are visited by increasing begin address, so everything below
+  // NEXT has been added already.
+  uint64_t next = start_addr;
+  for (const auto &range : ranges) {
+    if (!Contains(range.first)) continue;
+    uint64_t end = std::min(range.second, end_addr);
+    if (end <= next) continue;
+    uint64_t begin = std::max(range.first, next);
+    AddUnsampledInstructions(name, next, begin);
+    AddInstructions(name, begin, end);
+    next = end;
+  }
+  AddUnsampledInstructions(name, next, end_addr);
+}
+
+void InstructionMap::Reset(uint64_t start_addr, uint64_t end_addr) {
+  start_addr_ = start_addr;
+  inst_info_.clear();
+  sources_.clear();
+  if (start_addr < end_addr) {
+    inst_info_.resize(end_addr - start_addr, InstInfo{0, 0});
   }
-  for (uint64_t addr = start_addr; addr < end_addr; addr++) {
-    InstInfo *info = new InstInfo();
-    addr2line_->GetInlineStack(addr, &info->source_stack);
-    inst_map_.insert(InstMap::value_type(addr, info));
-    if (info->source_stack.size() > 0) {
-      symbol_map_->AddSourceCount(name, info->source_stack, 0, 1, 1,
+}
+
+void InstructionMap::AddInstructions(const std::string &name, uint64_t begin,
+                                     uint64_t end) {
+  for (uint64_t addr = begin; addr < end; addr++) {
+    InstInfo &info = inst_info_[addr - start_addr_];
+    info.begin = sources_.size();
+    addr2line_->GetInlineStack(addr, &sources_);
+    info.end = sources_.size();
+    if (info.end > info.begin) {
+      symbol_map_->AddSourceCount(name, GetSourceStack(addr), 0, 1, 1,
+                                  SymbolMap::PERFDATA);
+    }
+  }
+}
+
+void InstructionMap::AddUnsampledInstructions(const std::string &name,
+                                              uint64_t begin, uint64_t end) {
+  SourceStack stack;
+  for (uint64_t addr = begin; addr < end;) {
+    stack.clear();
+    addr2line_->GetInlineStack(addr, &stack);
+    uint64_t next = std::min(addr2line_->GetInlineStackRangeEnd(addr), end);
+    if (!stack.empty()) {
+      symbol_map_->AddSourceCount(name, stack, 0, next - addr, 1,
                                   SymbolMap::PERFDATA);
     }
+    addr = next;
   }
 }
 
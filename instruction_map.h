@@ -7,14 +7,16 @@
 #define AUTOFDO_INSTRUCTION_MAP_H_
 
 #include <cstdint>
-#include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "base/integral_types.h"
 #include "base/logging.h"
 #include "base/macros.h"
+#include "source_info.h"
 #include "symbol_map.h"
+#include "third_party/abseil/absl/types/span.h"
 
 
 namespace devtools_crosstool_autofdo {
@@ -33,36 +35,77 @@ class InstructionMap {
   //           according to the debug info of each instruction.
   InstructionMap(Addr2line *addr2line,
                  SymbolMap *symbol)
-      : symbol_map_(symbol), addr2line_(addr2line) {
+      : start_addr_(0), symbol_map_(symbol), addr2line_(addr2line) {
   }
 
-  // Deletes all the InstInfo, which was allocated in BuildInstMap.
-  ~InstructionMap();
-
   // Returns the size of the instruction map.
-  uint64_t size() const { return inst_map_.size(); }
+  uint64_t size() const { return inst_info_.size(); }
 
-  // Builds instruction map for a function.
+  // Builds instruction map for a function, replacing any previously built
+  // one.
   void BuildPerFunctionInstructionMap(const std::string &name,
                                       uint64_t start_addr, uint64_t end_addr);
 
-  // Contains information about each instruction.
-  struct InstInfo {
-    const SourceInfo &source(int i) const {
-      DCHECK(i >= 0 && source_stack.size() > i);
-      return source_stack[i];
-    }
-    SourceStack source_stack;
-  };
+  // Like BuildPerFunctionInstructionMap, but only stores the source stacks
+  // of the addresses in RANGES, a list of [begin, end) address ranges.
+  // Ranges that do not begin inside the function are ignored, the others
+  // are cut at END_ADDR. The map still covers the whole function, the
+  // addresses left out have an empty source stack. They are still added to
+  // the symbol map, one run of addresses with the same source stack at a
+  // time, so the symbol map ends up the same as with the full map.
+  void BuildSparsePerFunctionInstructionMap(
+      const std::string &name, uint64_t start_addr, uint64_t end_addr,
+      std::vector<std::pair<uint64_t, uint64_t>> ranges);
+
+  // Address range [start_addr, end_addr) covered by the instruction map.
+  uint64_t start_addr() const { return start_addr_; }
+  uint64_t end_addr() const { return start_addr_ + inst_info_.size(); }
+
+  // Returns true if ADDR is covered by the instruction map.
+  bool Contains(uint64_t addr) const {
+    return addr >= start_addr_ && addr < end_addr();
+  }
 
-  typedef std::map<uint64_t, InstInfo *> InstMap;
-  const InstMap &inst_map() const {
-    return inst_map_;
+  // Returns the source stack of the instruction at ADDR. The stack is empty
+  // if ADDR is not covered or has no debug info. The returned span is valid
+  // until the map is rebuilt or destroyed.
+  absl::Span<const SourceInfo> GetSourceStack(uint64_t addr) const {
+    if (!Contains(addr)) return absl::Span<const SourceInfo>();
+    const InstInfo &info = inst_info_[addr - start_addr_];
+    return absl::MakeConstSpan(sources_.data() + info.begin,
+                               info.end - info.begin);
   }
 
  private:
-  // A map from instruction address to its information.
-  InstMap inst_map_;
+  // Resets the map to cover [start_addr, end_addr) with empty source stacks.
+  void Reset(uint64_t start_addr, uint64_t end_addr);
+
+  // Symbolizes the addresses in [begin, end) and adds them to the function
+  // NAME in the symbol map.
+  void AddInstructions(const std::string &name, uint64_t begin, uint64_t end);
+
+  // Adds the addresses in [begin, end) to the function NAME in the symbol
+  // map like AddInstructions, but without storing their source stacks, and
+  // symbolizing only the first address of each run with the same stack.
+  void AddUnsampledInstructions(const std::string &name, uint64_t begin,
+                                uint64_t end);
+
+  // Contains information about each instruction: the slice of sources_
+  // holding its source stack.
+  struct InstInfo {
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  // First address covered by inst_info_.
+  uint64_t start_addr_;
+
+  // Per-byte instruction information, indexed by (addr - start_addr_).
+  std::vector<InstInfo> inst_info_;
+
+  // Source stacks of all instructions, stored back to back so that the whole
+  // function is freed in one shot.
+  SourceStack sources_;
 
   // A map from symbol name to symbol data.
   SymbolMap *symbol_map_;
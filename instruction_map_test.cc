@@ -47,6 +47,51 @@ TEST_F(InstructionMapTest, PerFunctionInstructionMap) {
       addr2line, &symbol_map);
   symbol_map.AddSymbol("longest_match");
   inst_map.BuildPerFunctionInstructionMap("longest_match", 0x401680, 0x401871);
+  EXPECT_EQ(0x401871 - 0x401680, inst_map.size());
+  EXPECT_TRUE(inst_map.Contains(0x401680));
+  EXPECT_FALSE(inst_map.Contains(0x401871));
+  EXPECT_FALSE(inst_map.GetSourceStack(0x401680).empty());
+  EXPECT_TRUE(inst_map.GetSourceStack(0x401871).empty());
+  EXPECT_TRUE(inst_map.GetSourceStack(0x40167f).empty());
+  delete addr2line;
+}
+
+TEST_F(InstructionMapTest, SparsePerFunctionInstructionMap) {
+  Addr2line *addr2line = Addr2line::Create(FLAGS_test_srcdir +
+                                           kTestDataDir + "test.binary");
+  devtools_crosstool_autofdo::SymbolMap symbol_map(
+      FLAGS_test_srcdir + kTestDataDir + "test.binary");
+  symbol_map.AddSymbol("longest_match");
+  devtools_crosstool_autofdo::InstructionMap dense_map(addr2line, &symbol_map);
+  dense_map.BuildPerFunctionInstructionMap("longest_match", 0x401680,
+                                           0x401871);
+  devtools_crosstool_autofdo::InstructionMap sparse_map(addr2line,
+                                                        &symbol_map);
+  // The second range is ignored as it starts before the function, the last
+  // one is cut at the end of the function.
+  sparse_map.BuildSparsePerFunctionInstructionMap(
+      "longest_match", 0x401680, 0x401871,
+      {{0x401700, 0x401710}, {0x401600, 0x401690}, {0x401705, 0x401720},
+       {0x401860, 0x401900}});
+  EXPECT_EQ(dense_map.size(), sparse_map.size());
+  for (uint64_t addr = 0x401680; addr < 0x401871; ++addr) {
+    bool sampled = (addr >= 0x401700 && addr < 0x401720) || addr >= 0x401860;
+    if (sampled) {
+      absl::Span<const devtools_crosstool_autofdo::SourceInfo> expected =
+          dense_map.GetSourceStack(addr);
+      absl::Span<const devtools_crosstool_autofdo::SourceInfo> actual =
+          sparse_map.GetSourceStack(addr);
+      ASSERT_EQ(expected.size(), actual.size());
+      for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_STREQ(expected[i].func_name, actual[i].func_name);
+        EXPECT_EQ(expected[i].line, actual[i].line);
+        EXPECT_EQ(expected[i].discriminator, actual[i].discriminator);
+      }
+    } else {
+      EXPECT_TRUE(sparse_map.GetSourceStack(addr).empty());
+    }
+  }
+  EXPECT_FALSE(sparse_map.GetSourceStack(0x401700).empty());
   delete addr2line;
 }
 }  // namespace
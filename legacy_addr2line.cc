@@ -18,7 +18,15 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
 #include "base/logging.h"
+#include "debug_file_finder.h"
 #include "symbolize/bytereader.h"
 #include "symbolize/dwarf2reader.h"
 #include "symbolize/dwarf3ranges.h"
@@ -26,6 +34,11 @@
 #include "symbolize/functioninfo.h"
 #include "symbolize/elf_reader.h"
 #include "symbol_map.h"
+#include "third_party/abseil/absl/flags/flag.h"
+
+ABSL_FLAG(int32_t, symbolize_threads, 0,
+          "Number of threads used to read debug info when symbolizing "
+          "without LLVM. 0 means one per hardware thread.");
 
 namespace {
 void GetSection(const devtools_crosstool_autofdo::SectionMap &sections,
@@ -56,6 +69,96 @@ void GetSection(const devtools_crosstool_autofdo::SectionMap &sections,
 
 namespace devtools_crosstool_autofdo {
 
+namespace {
+// Returns the offsets of the compilation units in .debug_info, in order.
+std::vector<uint64_t> GetCompilationUnitOffsets(const char *data, size_t size,
+                                                const ByteReader &reader) {
+  std::vector<uint64_t> offsets;
+  uint64_t pos = 0;
+  while (pos + 4 <= size) {
+    offsets.push_back(pos);
+    uint64_t length = reader.ReadFourBytes(data + pos);
+    uint64_t header_size = 4;
+    if (length == 0xffffffff) {
+      if (pos + 12 > size) break;
+      length = reader.ReadEightBytes(data + pos + 4);
+      header_size = 12;
+    }
+    if (length > size - pos - header_size) break;
+    pos += header_size + length;
+  }
+  return offsets;
+}
+
+// Reads a contiguous slice of the compilation units in .debug_info into a
+// line map and inline stack handler of its own, so that slices can be read
+// concurrently and merged afterwards.
+class CompilationUnitSlice {
+ public:
+  CompilationUnitSlice(const string &binary_name, const SectionMap &sections,
+                       int address_size, const char *debug_ranges_data,
+                       size_t debug_ranges_size,
+                       const char *debug_rnglists_data,
+                       size_t debug_rnglists_size,
+                       const char *debug_addr_data, size_t debug_addr_size,
+                       const map<uint64_t, uint64_t> *sampled_functions,
+                       uint64_t vaddr_of_first_load_segment)
+      : binary_name_(binary_name), sections_(sections),
+        reader_(ENDIANNESS_LITTLE),
+        debug_ranges_(debug_ranges_data, debug_ranges_size,
+                      debug_rnglists_data, debug_rnglists_size,
+                      debug_addr_data, debug_addr_size, &reader_),
+        inline_stack_handler_(&debug_ranges_, sections, &reader_,
+                              sampled_functions, vaddr_of_first_load_segment),
+        sampled_functions_(sampled_functions), malformed_(false) {
+    reader_.SetAddressSize(address_size);
+  }
+
+  // Reads the compilation units starting at OFFSETS[BEGIN, END). Stops at
+  // the first malformed one.
+  void Read(const std::vector<uint64_t> &offsets, size_t begin, size_t end) {
+    // Most units share their abbreviation table with others.
+    AbbrevTableCache abbrev_cache;
+    for (size_t i = begin; i < end; ++i) {
+      DirectoryVector dirs;
+      FileVector files;
+      CULineInfoHandler handler(&files, &dirs, &line_map_, sampled_functions_);
+      inline_stack_handler_.set_directory_names(&dirs);
+      inline_stack_handler_.set_file_names(&files);
+      inline_stack_handler_.set_line_handler(&handler);
+      CompilationUnit compilation_unit(
+          binary_name_, sections_, offsets[i], &reader_,
+          &inline_stack_handler_);
+      compilation_unit.set_abbrev_cache(&abbrev_cache);
+      compilation_unit.Start();
+      if (compilation_unit.malformed()) {
+        malformed_ = true;
+        break;
+      }
+    }
+    inline_stack_handler_.set_directory_names(NULL);
+    inline_stack_handler_.set_file_names(NULL);
+    inline_stack_handler_.set_line_handler(NULL);
+  }
+
+  bool malformed() const { return malformed_; }
+  AddressToLineMap *line_map() { return &line_map_; }
+  InlineStackHandler *inline_stack_handler() { return &inline_stack_handler_; }
+
+ private:
+  const string &binary_name_;
+  const SectionMap &sections_;
+  ByteReader reader_;
+  AddressRangeList debug_ranges_;
+  AddressToLineMap line_map_;
+  InlineStackHandler inline_stack_handler_;
+  const map<uint64_t, uint64_t> *sampled_functions_;
+  bool malformed_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompilationUnitSlice);
+};
+}  // namespace
+
 Addr2line *Addr2line::Create(const string &binary_name) {
   return CreateWithSampledFunctions(binary_name, NULL);
 }
@@ -74,7 +177,8 @@ Addr2line *Addr2line::CreateWithSampledFunctions(
 Google3Addr2line::Google3Addr2line(const string &binary_name,
                                    const map<uint64_t, uint64_t> *sampled_functions)
     : Addr2line(binary_name), line_map_(new AddressToLineMap()),
-      inline_stack_handler_(NULL), elf_(new ElfReader(binary_name)),
+      inline_stack_handler_(NULL),
+      elf_(new ElfReader(FindDebugFile(binary_name))),
       sampled_functions_(sampled_functions) {}
 
 Google3Addr2line::~Google3Addr2line() {
@@ -96,13 +200,23 @@ bool Google3Addr2line::Prepare() {
     LOG(ERROR) << "'" << binary_name_ << "' is not an ELF file";
     return false;
   }
+  // The debug sections of a relocatable object, such as a kernel module,
+  // would need their relocations applied first.
+  if (elf_->IsRelocatableObject()) {
+    LOG(ERROR) << "'" << binary_name_ << "' is a relocatable object, which "
+               << "is only supported by the LLVM symbolizer";
+    return false;
+  }
   reader.SetAddressSize(width);
 
   SectionMap sections;
   const char *debug_section_names[] = {
     ".debug_line", ".debug_abbrev", ".debug_info", ".debug_line", ".debug_str",
-    ".debug_ranges", ".debug_addr"
+    ".debug_ranges", ".debug_addr", ".debug_line_str", ".debug_str_offsets",
+    ".debug_rnglists"
   };
+  elf_->DecompressSections(vector<string>(std::begin(debug_section_names),
+                                          std::end(debug_section_names)));
   for (const char *section_name : debug_section_names) {
     size_t section_size;
     const char *section_data = elf_->GetSectionByName(section_name,
@@ -112,14 +226,37 @@ bool Google3Addr2line::Prepare() {
     sections[section_name] = std::make_pair(section_data, section_size);
   }
 
+  const char *debug_info_data = NULL;
   size_t debug_info_size = 0;
   size_t debug_ranges_size = 0;
   const char *debug_ranges_data = NULL;
-  GetSection(sections, ".debug_info", NULL, &debug_info_size, binary_name_, "");
-  GetSection(sections, ".debug_ranges", &debug_ranges_data,
-             &debug_ranges_size, binary_name_, "");
+  size_t debug_rnglists_size = 0;
+  const char *debug_rnglists_data = NULL;
+  size_t debug_addr_size = 0;
+  const char *debug_addr_data = NULL;
+  GetSection(sections, ".debug_info", &debug_info_data, &debug_info_size,
+             binary_name_, "");
+  // DWARF 5 has its range lists in .debug_rnglists instead of
+  // .debug_ranges, and refers to addresses in .debug_addr as does split
+  // DWARF: only warn when neither kind of range list is there.
+  if (sections.count(".debug_ranges") || !sections.count(".debug_rnglists")) {
+    GetSection(sections, ".debug_ranges", &debug_ranges_data,
+               &debug_ranges_size, binary_name_, "");
+  }
+  if (sections.count(".debug_rnglists")) {
+    GetSection(sections, ".debug_rnglists", &debug_rnglists_data,
+               &debug_rnglists_size, binary_name_, "");
+  }
+  if (sections.count(".debug_addr")) {
+    GetSection(sections, ".debug_addr", &debug_addr_data, &debug_addr_size,
+               binary_name_, "");
+  }
   AddressRangeList debug_ranges(debug_ranges_data,
                                                 debug_ranges_size,
+                                                debug_rnglists_data,
+                                                debug_rnglists_size,
+                                                debug_addr_data,
+                                                debug_addr_size,
                                                 &reader);
   inline_stack_handler_ = new InlineStackHandler(
       &debug_ranges, sections, &reader, sampled_functions_,
@@ -130,19 +267,48 @@ bool Google3Addr2line::Prepare() {
   // .debug_info. Otherwise, we'll iterate through .debug_line section,
   // assuming that compilation units are stored continuously in it.
   if (debug_info_size > 0) {
-    size_t debug_info_pos = 0;
-    while (debug_info_pos < debug_info_size) {
-      DirectoryVector dirs;
-      FileVector files;
-      CULineInfoHandler handler(&files, &dirs, line_map_, sampled_functions_);
-      inline_stack_handler_->set_directory_names(&dirs);
-      inline_stack_handler_->set_file_names(&files);
-      inline_stack_handler_->set_line_handler(&handler);
-      CompilationUnit compilation_unit(
-          binary_name_, sections, debug_info_pos, &reader,
-          inline_stack_handler_);
-      debug_info_pos += compilation_unit.Start();
-      if (compilation_unit.malformed()) {
+    // Compilation units are independent of each other, so they are read in
+    // contiguous slices by a pool of threads, each into its own line map and
+    // inline stack handler. The slices are merged back in order.
+    std::vector<uint64_t> cu_offsets =
+        GetCompilationUnitOffsets(debug_info_data, debug_info_size, reader);
+    int num_threads = absl::GetFlag(FLAGS_symbolize_threads);
+    if (num_threads <= 0)
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::min<size_t>(num_threads, cu_offsets.size());
+    num_threads = std::max(num_threads, 1);
+
+    std::vector<std::unique_ptr<CompilationUnitSlice>> slices;
+    for (int i = 0; i < num_threads; ++i) {
+      slices.emplace_back(new CompilationUnitSlice(
+          binary_name_, sections, width, debug_ranges_data, debug_ranges_size,
+          debug_rnglists_data, debug_rnglists_size, debug_addr_data,
+          debug_addr_size, sampled_functions_,
+          elf_->VaddrOfFirstLoadSegment()));
+    }
+    // Balance the slices by size rather than by number of units.
+    std::vector<size_t> bounds(num_threads + 1, cu_offsets.size());
+    bounds[0] = 0;
+    for (int i = 1, cu = 0; i < num_threads; ++i) {
+      const uint64_t target = debug_info_size / num_threads * i;
+      while (cu < cu_offsets.size() && cu_offsets[cu] < target) ++cu;
+      bounds[i] = cu;
+    }
+    if (num_threads == 1) {
+      slices[0]->Read(cu_offsets, bounds[0], bounds[1]);
+    } else {
+      std::vector<std::thread> threads;
+      for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back(&CompilationUnitSlice::Read, slices[i].get(),
+                             std::cref(cu_offsets), bounds[i], bounds[i + 1]);
+      }
+      for (std::thread &thread : threads) thread.join();
+    }
+
+    for (const auto &slice : slices) {
+      line_map_->Append(slice->line_map());
+      inline_stack_handler_->Merge(slice->inline_stack_handler());
+      if (slice->malformed()) {
         LOG(WARNING) << "File '" << binary_name_ << "' has mangled "
                      << ".debug_info section.";
         // If the compilation unit is malformed, we do not know how
@@ -154,13 +320,21 @@ bool Google3Addr2line::Prepare() {
     const char *data;
     size_t size;
     GetSection(sections, ".debug_line", &data, &size, binary_name_, "");
+    // DWARF 5 line programs may name their files in .debug_line_str.
+    const char *line_str_data = NULL;
+    size_t line_str_size = 0;
+    if (sections.count(".debug_line_str")) {
+      GetSection(sections, ".debug_line_str", &line_str_data,
+                 &line_str_size, binary_name_, "");
+    }
     if (data) {
       size_t pos = 0;
       while (pos < size) {
         DirectoryVector dirs;
         FileVector files;
         CULineInfoHandler handler(&files, &dirs, line_map_);
-        LineInfo line(data + pos, size - pos, &reader, &handler);
+        LineInfo line(data + pos, size - pos, line_str_data, line_str_size,
+                      &reader, &handler);
         uint64_t read = line.Start();
         if (line.malformed()) {
           // If the debug_line section is malformed, we should stop
@@ -173,6 +347,7 @@ bool Google3Addr2line::Prepare() {
       }
     }
   }
+  line_map_->Freeze();
   inline_stack_handler_->PopulateSubprogramsByAddress();
 
   return true;
@@ -233,4 +408,13 @@ void Google3Addr2line::GetInlineStack(uint64_t address,
     subprog = subprog->parent();
   }
 }
+
+uint64_t Google3Addr2line::GetInlineStackRangeEnd(uint64_t address) const {
+  // GetInlineStack only depends on the line entry and the subprogram
+  // covering ADDRESS.
+  AddressToLineMap::const_iterator iter = line_map_->upper_bound(address);
+  uint64_t end = iter == line_map_->end() ? ~0ULL : iter->first;
+  return std::min<uint64_t>(
+      end, inline_stack_handler_->GetSubprogramRangeEnd(address));
+}
 }  // namespace autofdo
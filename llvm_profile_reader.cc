@@ -1,5 +1,10 @@
 #include "llvm_profile_reader.h"
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "parallel_for.h"
 #include "symbol_map.h"
 #include "llvm/Config/llvm-config.h"
 #include "llvm/ProfileData/SampleProfReader.h"
@@ -7,7 +12,8 @@
 namespace devtools_crosstool_autofdo {
 
 const char *LLVMProfileReader::GetName(const llvm::StringRef &N) {
-  return names_.insert(N.str()).first->c_str();
+  return FunctionNameTable::Intern(absl::string_view(N.data(), N.size()))
+      .data();
 }
 
 #if LLVM_VERSION_MAJOR >= 12
@@ -47,27 +53,36 @@ bool LLVMProfileReader::ReadFromFile(const std::string &filename) {
     SetProfileSymbolList(std::move(prof_sym_list));
   }
 
+  // The symbols are added, or skipped, serially, as shouldMergeProfileForSym
+  // may add and remove symbols. Then the samples of each function only go to
+  // its own symbol, so the functions can be read in parallel.
+  std::vector<const llvm::sampleprof::FunctionSamples *> profiles;
   for (const auto &name_profile : reader->getProfiles()) {
-    SourceStack stack;
-    ReadFromFunctionSamples(stack, name_profile.second);
+    const llvm::sampleprof::FunctionSamples &fs = name_profile.second;
+    const char *func_name = GetName(fs.getName());
+    if (!shouldMergeProfileForSym(func_name)) continue;
+    symbol_map_->AddSymbol(func_name);
+    symbol_map_->AddSymbolEntryCount(func_name, fs.getHeadSamples());
+    profiles.push_back(&fs);
+  }
+
+  int num_threads = num_threads_;
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
   }
+  if (num_threads > 1) symbol_map_->set_concurrent_accumulation(true);
+  ParallelFor(profiles.size(), num_threads, [&](size_t i) {
+    ReadFromFunctionSamples(SourceStack(), *profiles[i]);
+  });
+  if (num_threads > 1) symbol_map_->set_concurrent_accumulation(false);
   return true;
 }
 
 void LLVMProfileReader::ReadFromFunctionSamples(
     const SourceStack &stack, const llvm::sampleprof::FunctionSamples &fs) {
   const char *func_name = GetName(fs.getName());
-
-  if (stack.empty() && !shouldMergeProfileForSym(func_name)) return;
-
-  const char *top_func_name = nullptr;
-  if (stack.empty()) {
-    top_func_name = func_name;
-    symbol_map_->AddSymbol(func_name);
-    symbol_map_->AddSymbolEntryCount(func_name, fs.getHeadSamples());
-  } else {
-    top_func_name = stack.back().func_name;
-  }
+  const char *top_func_name =
+      stack.empty() ? func_name : stack.back().func_name;
   for (const auto &loc_sample : fs.getBodySamples()) {
     SourceInfo info(func_name, "", "", 0, loc_sample.first.LineOffset,
                     loc_sample.first.Discriminator);
@@ -40,9 +40,8 @@ struct SpecialSyms {
 class LLVMProfileReader : public ProfileReader {
  public:
   explicit LLVMProfileReader(SymbolMap *symbol_map,
-                             absl::node_hash_set<std::string>& names,
                              SpecialSyms *special_syms = nullptr)
-      : symbol_map_(symbol_map), names_(names), special_syms_(special_syms) {}
+      : symbol_map_(symbol_map), special_syms_(special_syms) {}
 
 #if LLVM_VERSION_MAJOR >= 12
   bool ReadFromFile(const std::string &output_file) override {
@@ -66,16 +65,24 @@ class LLVMProfileReader : public ProfileReader {
     return prof_sym_list_.get();
   }
 
+  // Sets the number of threads that add the samples of the functions in a
+  // profile to the symbol map, each function on one thread. 0 means one per
+  // CPU. The symbols are added serially beforehand.
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
  private:
+  // Returns the copy of N interned in FunctionNameTable.
   const char *GetName(const llvm::StringRef &N);
 
+  // Adds the samples of FS, inlined at STACK, to the symbol of the outline
+  // function, which has to be in the symbol map already.
   void ReadFromFunctionSamples(const SourceStack &stack,
                                const llvm::sampleprof::FunctionSamples &fs);
 
   SymbolMap *symbol_map_;
-  absl::node_hash_set<std::string>& names_;
   SpecialSyms *special_syms_;
   std::unique_ptr<llvm::sampleprof::ProfileSymbolList> prof_sym_list_;
+  int num_threads_ = 1;
 };
 }  // namespace devtools_crosstool_autofdo
 
@@ -2,11 +2,16 @@
 
 #include "llvm_profile_reader.h"
 
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+
 #include "base/commandlineflags.h"
 #include "symbol_map.h"
 #include "gtest/gtest.h"
-#include "third_party/abseil/absl/container/node_hash_set.h"
 #include "third_party/abseil/absl/flags/flag.h"
+#include "third_party/abseil/absl/strings/str_cat.h"
 
 #define FLAGS_test_tmpdir std::string(testing::UnitTest::GetInstance()->original_working_dir())
 
@@ -27,13 +32,18 @@ void VerifySymbolMap(const devtools_crosstool_autofdo::SymbolMap &symbol_map) {
   data = symbol_map.map().at("main");
 
   EXPECT_EQ(data->pos_counts.size(), 16);
-  EXPECT_EQ(data->callsites.size(), 1);
+  ASSERT_EQ(data->callsites.size(), 1);
+  // The reader interns the names of the inlined callees.
+  const char *callee = data->callsites.begin()->first.second;
+  EXPECT_STREQ(callee, "_Z8computeii");
+  EXPECT_EQ(callee,
+            devtools_crosstool_autofdo::FunctionNameTable::Intern(callee)
+                .data());
 }
 
 TEST(LLVMProfileReaderTest, ReadBinaryTest) {
   devtools_crosstool_autofdo::SymbolMap symbol_map;
-  absl::node_hash_set<std::string> names;
-  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map, names);
+  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map);
   reader.ReadFromFile(FLAGS_test_srcdir +
                       "/testdata/"
                       "llvm_autoprof.golden.binprof");
@@ -42,8 +52,7 @@ TEST(LLVMProfileReaderTest, ReadBinaryTest) {
 
 TEST(LLVMProfileReaderTest, ReadTextTest) {
   devtools_crosstool_autofdo::SymbolMap symbol_map;
-  absl::node_hash_set<std::string> names;
-  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map, names);
+  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map);
   EXPECT_TRUE(
       reader.ReadFromFile(FLAGS_test_srcdir +
                           "/testdata/"
@@ -54,8 +63,7 @@ TEST(LLVMProfileReaderTest, ReadTextTest) {
 
 TEST(LLVMProfileReaderTest, ReadEmptyBodyNonZeroFunctionTotalTest) {
   devtools_crosstool_autofdo::SymbolMap symbol_map;
-  absl::node_hash_set<std::string> names;
-  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map, names);
+  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map);
   reader.ReadFromFile(FLAGS_test_srcdir +
                       "/testdata/"
                       "llvm_testzero.golden.textprof");
@@ -64,4 +72,80 @@ TEST(LLVMProfileReaderTest, ReadEmptyBodyNonZeroFunctionTotalTest) {
 
   EXPECT_EQ(data->total_count, 1000);
 }
+
+// Returns "LINE.DISCRIMINATOR" of OFFSET.
+std::string PrintOffset(uint64_t offset) {
+  using devtools_crosstool_autofdo::SourceInfo;
+  return absl::StrCat(SourceInfo::GetLineNumberFromOffset(offset), ".",
+                      SourceInfo::GetDiscriminatorFromOffset(offset));
+}
+
+// Returns the counts of SYMBOL and of its inline instances, with the call
+// targets, as a string.
+std::string DumpSymbol(const devtools_crosstool_autofdo::Symbol *symbol) {
+  std::string dump = absl::StrCat(symbol->info.func_name, " ",
+                                  symbol->head_count, " ",
+                                  symbol->total_count, " {");
+  for (const auto &[offset, info] : symbol->pos_counts) {
+    absl::StrAppend(&dump, " ", PrintOffset(offset), ":", info.count, "/",
+                    info.num_inst);
+    devtools_crosstool_autofdo::TargetCountPairs target_counts;
+    devtools_crosstool_autofdo::GetTargetCountPairsByName(info.target_map,
+                                                          &target_counts);
+    for (const auto &[target, count] : target_counts) {
+      absl::StrAppend(&dump, " ", target, "=", count);
+    }
+  }
+  // The callsites are ordered by the address of the callee name: sort them.
+  std::map<std::string, std::string> callsites;
+  for (const auto &[callsite, callee] : symbol->callsites) {
+    callsites[absl::StrCat(PrintOffset(callsite.first), " ", callsite.second)] =
+        DumpSymbol(callee);
+  }
+  for (const auto &[callsite, callee] : callsites) {
+    absl::StrAppend(&dump, " ", callsite, ": ", callee);
+  }
+  return absl::StrCat(dump, " }");
+}
+
+// Reads PROFILE with NUM_THREADS threads and returns the dumps of the
+// symbols.
+std::map<std::string, std::string> ReadProfile(const std::string &profile,
+                                               int num_threads) {
+  devtools_crosstool_autofdo::SymbolMap symbol_map;
+  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map);
+  reader.set_num_threads(num_threads);
+  EXPECT_TRUE(reader.ReadFromFile(profile));
+  std::map<std::string, std::string> dumps;
+  for (const auto &[name, symbol] : symbol_map.map()) {
+    dumps[name] = DumpSymbol(symbol);
+  }
+  return dumps;
+}
+
+TEST(LLVMProfileReaderTest, ReadInParallel) {
+  // Enough functions for 4 threads, each with call targets and an inline
+  // instance whose samples go to the outline function.
+  const int kNumFunctions = 256;
+  std::string text;
+  for (int i = 0; i < kNumFunctions; ++i) {
+    absl::StrAppend(&text, "func", i, ":", 1000 + i, ":", i, "\n",
+                    " 1: ", 100 + i, "\n",
+                    " 2: ", 30 + i, " target_a:", 20 + i, " target_b:10\n",
+                    " 3: callee:500\n",
+                    "  1: 400\n",
+                    "  2: 100 target_a:", 60 + i, "\n");
+  }
+  const std::string profile = FLAGS_test_tmpdir + "/parallel_read.txt";
+  std::ofstream(profile) << text;
+
+  const std::map<std::string, std::string> serial = ReadProfile(profile, 1);
+  const std::map<std::string, std::string> parallel = ReadProfile(profile, 4);
+  remove(profile.c_str());
+  ASSERT_EQ(serial.size(), kNumFunctions);
+  EXPECT_EQ(parallel, serial);
+  EXPECT_EQ(parallel.at("func7"),
+            "func7 7 644 { 1.0:107/1 2.0:37/1 target_a=27 target_b=10 "
+            "3.0 callee: callee 0 500 { 1.0:400/1 2.0:100/1 target_a=67 } }");
+}
 }  // namespace
@@ -129,11 +129,11 @@ void LLVMProfileBuilder::Visit(const Symbol *node) {
     // or more functions.
     const auto &target_map = pos_count.second.target_map;
     for (const auto &target_count : target_map) {
+      absl::string_view target = FunctionNameTable::Name(target_count.first);
       if (std::error_code EC = llvm::MergeResult(
               result_, profile.addCalledTargetSamples(
                            line, discriminator,
-                           llvm::StringRef(target_count.first.data(),
-                                           target_count.first.size()),
+                           llvm::StringRef(target.data(), target.size()),
                            target_count.second)))
         LOG(FATAL) << "Error updating called target samples for '"
                    << node->info.func_name << "': " << EC.message();
@@ -143,14 +143,16 @@ void LLVMProfileBuilder::Visit(const Symbol *node) {
 
 llvm::StringRef LLVMProfileBuilder::GetNameRef(const std::string &str) {
   StringIndexMap::const_iterator ret =
-      name_table_.find(Symbol::Name(str.c_str()));
+      name_table_.find(FunctionNameTable::Id(Symbol::Name(str.c_str())));
   CHECK(ret != name_table_.end());
+  // The interned name outlives the profiles that refer to it.
+  absl::string_view name = FunctionNameTable::Name(ret->first);
   // Suffixes should have been elided by SymbolMap::ElideSuffixesAndMerge()
-  if (absl::StrContains(ret->first, ".llvm.")) {
-    LOG(WARNING) << "Unexpected character '.' in function name: " << ret->first
+  if (absl::StrContains(name, ".llvm.")) {
+    LOG(WARNING) << "Unexpected character '.' in function name: " << name
                << ". Likely thin LTO .llvm.<hash> suffix has not been cleared.";
   }
-  return llvm::StringRef(ret->first.c_str());
+  return llvm::StringRef(name.data(), name.size());
 }
 
 llvm::sampleprof::SampleProfileWriter *LLVMProfileWriter::CreateSampleWriter(
@@ -0,0 +1,40 @@
+// Helper to run the iterations of a loop on several threads.
+
+#ifndef AUTOFDO_PARALLEL_FOR_H_
+#define AUTOFDO_PARALLEL_FOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace devtools_crosstool_autofdo {
+
+// Minimum number of items that ParallelFor gives each thread, so that small
+// batches are not worth a thread.
+constexpr size_t kMinItemsPerThread = 16;
+
+// Calls FN(I) for each I in [0, N), from up to NUM_THREADS threads. The
+// calling thread is one of them. The items are handed out one at a time, in
+// increasing order.
+template <typename Fn>
+void ParallelFor(size_t n, int num_threads, const Fn &fn) {
+  num_threads = std::min<size_t>(num_threads, n / kMinItemsPerThread);
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < n; ++i) fn(i);
+    return;
+  }
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    for (size_t i = next++; i < n; i = next++) fn(i);
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; ++i) threads.emplace_back(work);
+  work();
+  for (std::thread &thread : threads) thread.join();
+}
+
+}  // namespace devtools_crosstool_autofdo
+
+#endif  // AUTOFDO_PARALLEL_FOR_H_
@@ -4,6 +4,7 @@
 // Class to represent source level profile.
 #include "profile.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <map>
 #include <string>
@@ -17,75 +18,147 @@
 #include "symbol_map.h"
 #include "third_party/abseil/absl/flags/flag.h"
 #include "third_party/abseil/absl/strings/match.h"
+#include "third_party/abseil/absl/strings/str_cat.h"
 #include "third_party/abseil/absl/strings/strip.h"
+#include "third_party/abseil/absl/types/span.h"
 
 ABSL_FLAG(bool, use_lbr, true,
             "Whether to use lbr profile.");
 ABSL_FLAG(bool, llc_misses, false, "The profile represents llc misses.");
+ABSL_FLAG(bool, sparse_instruction_map, false,
+          "Only symbolize the instructions covered by samples one by one. "
+          "The others are symbolized once per run of addresses with the "
+          "same inline stack. The profile is the same either way.");
+
+namespace {
+// Returns the address ranges that ProcessPerFunctionProfile looks up in the
+// instruction map: the sampled ranges (or addresses, without LBR) and the
+// sources of the sampled branches.
+std::vector<std::pair<uint64_t, uint64_t>> GetSampledAddressRanges(
+    const std::vector<std::pair<uint64_t, uint64_t>> &address_counts,
+    const std::vector<std::pair<devtools_crosstool_autofdo::Range, uint64_t>>
+        &range_counts,
+    const std::vector<std::pair<devtools_crosstool_autofdo::Branch, uint64_t>>
+        &branch_counts) {
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  if (absl::GetFlag(FLAGS_use_lbr)) {
+    for (const auto &range_count : range_counts) {
+      ranges.emplace_back(range_count.first.first,
+                          range_count.first.second + 1);
+    }
+  } else {
+    for (const auto &address_count : address_counts) {
+      ranges.emplace_back(address_count.first, address_count.first + 1);
+    }
+  }
+  for (const auto &branch_count : branch_counts) {
+    ranges.emplace_back(branch_count.first.first,
+                        branch_count.first.first + 1);
+  }
+  return ranges;
+}
+}  // namespace
 
 namespace devtools_crosstool_autofdo {
-Profile::ProfileMaps *Profile::GetProfileMaps(uint64_t addr) {
-  const std::string *name;
-  uint64_t start_addr, end_addr;
-  if (symbol_map_->GetSymbolInfoByAddr(addr, &name,
-                                       &start_addr, &end_addr)) {
+Profile::ProfileMaps *Profile::GetProfileMaps(
+    FunctionAddressTable::SortedLookup *lookup, uint64_t addr) {
+  size_t i = lookup->Find(addr);
+  if (i == FunctionAddressTable::kNotFound) {
+    return nullptr;
+  }
+  return GetProfileMapsForFunction(i);
+}
+
+Profile::ProfileMaps *Profile::GetProfileMapsForFunction(size_t i) {
+  if (i == last_function_) {
+    return last_profile_maps_;
+  }
+  ProfileMaps *&maps = function_profile_maps_[i];
+  if (maps == nullptr) {
+    const FunctionAddressTable &functions =
+        symbol_map_->function_address_table();
     std::pair<SymbolProfileMaps::iterator, bool> ret =
         symbol_profile_maps_.insert(
-            SymbolProfileMaps::value_type(*name, nullptr));
+            SymbolProfileMaps::value_type(functions.name(i), nullptr));
     if (ret.second) {
-      ret.first->second = new ProfileMaps(start_addr, end_addr);
+      ret.first->second =
+          new ProfileMaps(functions.start(i), functions.end(i));
     }
-    return ret.first->second;
-  } else {
-    return nullptr;
+    maps = ret.first->second;
+  }
+  last_function_ = i;
+  last_profile_maps_ = maps;
+  return maps;
+}
+
+void Profile::AddProfileMapsForSymbol(const std::string &name) {
+  const auto name_addr = symbol_map_->GetNameAddrMap().find(name);
+  if (name_addr == symbol_map_->GetNameAddrMap().end()) {
+    return;
+  }
+  const FunctionAddressTable &functions =
+      symbol_map_->function_address_table();
+  size_t i = functions.Find(name_addr->second);
+  // An alias is emitted under the name of the function it aliases.
+  if (i != FunctionAddressTable::kNotFound && functions.name(i) == name) {
+    GetProfileMapsForFunction(i);
   }
 }
 
 void Profile::AggregatePerFunctionProfile() {
   uint64_t start = symbol_map_->base_addr();
+  const FunctionAddressTable &functions =
+      symbol_map_->function_address_table();
+  // The sample maps are ordered by (source) address, so each of them is
+  // split by function with a single forward scan of the function address
+  // table, and the counts of a function are appended in order. Functions
+  // without samples get no profile maps.
   const AddressCountMap *count_map = &sample_reader_->address_count_map();
+  FunctionAddressTable::SortedLookup count_lookup(functions);
   for (const auto &addr_count : *count_map) {
-    ProfileMaps *maps = GetProfileMaps(addr_count.first + start);
+    ProfileMaps *maps =
+        GetProfileMaps(&count_lookup, addr_count.first + start);
     if (maps != nullptr) {
-      maps->address_count_map[addr_count.first + start] += addr_count.second;
+      maps->address_counts.emplace_back(addr_count.first + start,
+                                        addr_count.second);
     }
   }
   const RangeCountMap *range_map = &sample_reader_->range_count_map();
+  FunctionAddressTable::SortedLookup range_lookup(functions);
   for (const auto &range_count : *range_map) {
-    ProfileMaps *maps = GetProfileMaps(range_count.first.first + start);
+    ProfileMaps *maps =
+        GetProfileMaps(&range_lookup, range_count.first.first + start);
     if (maps != nullptr) {
-      maps->range_count_map[std::make_pair(range_count.first.first + start,
-                                           range_count.first.second + start)] +=
-          range_count.second;
+      maps->range_counts.emplace_back(
+          std::make_pair(range_count.first.first + start,
+                         range_count.first.second + start),
+          range_count.second);
     }
   }
   const BranchCountMap *branch_map = &sample_reader_->branch_count_map();
+  FunctionAddressTable::SortedLookup branch_lookup(functions);
   for (const auto &branch_count : *branch_map) {
-    ProfileMaps *maps = GetProfileMaps(branch_count.first.first + start);
+    ProfileMaps *maps =
+        GetProfileMaps(&branch_lookup, branch_count.first.first + start);
     if (maps != nullptr) {
-      maps->branch_count_map[std::make_pair(
-          branch_count.first.first + start,
-          branch_count.first.second + start)] += branch_count.second;
+      maps->branch_counts.emplace_back(
+          std::make_pair(branch_count.first.first + start,
+                         branch_count.first.second + start),
+          branch_count.second);
     }
   }
-
-  // Add an entry for each symbol so that later we can decide if the hot and
-  // cold parts together need to be emitted.
-  for (const auto &[name, addr] : symbol_map_->GetNameAddrMap()) {
-    CHECK(GetProfileMaps(addr));
-  }
 }
 
 uint64_t Profile::ProfileMaps::GetAggregatedCount() const {
   uint64_t ret = 0;
 
-  if (!range_count_map.empty()) {
-    for (const auto &range_count : range_count_map) {
+  if (!range_counts.empty()) {
+    for (const auto &range_count : range_counts) {
       ret += range_count.second * (1 + range_count.first.second -
                                    range_count.first.first);
     }
   } else {
-    for (const auto &addr_count : address_count_map) {
+    for (const auto &addr_count : address_counts) {
       ret += addr_count.second;
     }
   }
@@ -95,55 +168,52 @@ uint64_t Profile::ProfileMaps::GetAggregatedCount() const {
 void Profile::ProcessPerFunctionProfile(std::string func_name,
                                         const ProfileMaps &maps) {
   InstructionMap inst_map(addr2line_, symbol_map_);
-  inst_map.BuildPerFunctionInstructionMap(func_name, maps.start_addr,
-                                          maps.end_addr);
+  if (absl::GetFlag(FLAGS_sparse_instruction_map)) {
+    inst_map.BuildSparsePerFunctionInstructionMap(
+        func_name, maps.start_addr, maps.end_addr,
+        GetSampledAddressRanges(maps.address_counts, maps.range_counts,
+                                maps.branch_counts));
+  } else {
+    inst_map.BuildPerFunctionInstructionMap(func_name, maps.start_addr,
+                                            maps.end_addr);
+  }
 
-  AddressCountMap map;
-  const AddressCountMap *map_ptr;
+  // The counts by address, sorted by address.
+  const std::vector<std::pair<uint64_t, uint64_t>> *counts =
+      &maps.address_counts;
+  std::vector<std::pair<uint64_t, uint64_t>> range_address_counts;
   if (absl::GetFlag(FLAGS_use_lbr)) {
-    if (maps.range_count_map.empty()) {
+    if (maps.range_counts.empty()) {
       LOG(WARNING) << "use_lbr was enabled but range_count_map was empty!";
       return;
     }
-    for (const auto &range_count : maps.range_count_map) {
-      for (InstructionMap::InstMap::const_iterator iter =
-               inst_map.inst_map().find(range_count.first.first);
-           iter != inst_map.inst_map().end()
-               && iter->first <= range_count.first.second;
-           ++iter) {
-        map[iter->first] += range_count.second;
+    AddressCountMap map;
+    for (const auto &range_count : maps.range_counts) {
+      if (!inst_map.Contains(range_count.first.first)) {
+        continue;
+      }
+      uint64_t end = std::min(range_count.first.second + 1,
+                              inst_map.end_addr());
+      for (uint64_t addr = range_count.first.first; addr < end; ++addr) {
+        map[addr] += range_count.second;
       }
     }
-    map_ptr = &map;
-  } else {
-    map_ptr = &maps.address_count_map;
+    range_address_counts.assign(map.begin(), map.end());
+    counts = &range_address_counts;
   }
 
-  for (const auto &address_count : *map_ptr) {
-    InstructionMap::InstMap::const_iterator iter =
-        inst_map.inst_map().find(address_count.first);
-    if (iter == inst_map.inst_map().end()) {
-      continue;
-    }
-    const InstructionMap::InstInfo *info = iter->second;
-    if (info == nullptr) {
-      continue;
-    }
-    if (!info->source_stack.empty()) {
+  for (const auto &address_count : *counts) {
+    absl::Span<const SourceInfo> source_stack =
+        inst_map.GetSourceStack(address_count.first);
+    if (!source_stack.empty()) {
       symbol_map_->AddSourceCount(
-          func_name, info->source_stack, address_count.second, 0,
-          info->source_stack[0].DuplicationFactor(), SymbolMap::PERFDATA);
+          func_name, source_stack, address_count.second, 0,
+          source_stack[0].DuplicationFactor(), SymbolMap::PERFDATA);
     }
   }
 
-  for (const auto &branch_count : maps.branch_count_map) {
-    InstructionMap::InstMap::const_iterator iter =
-        inst_map.inst_map().find(branch_count.first.first);
-    if (iter == inst_map.inst_map().end()) {
-      continue;
-    }
-    const InstructionMap::InstInfo *info = iter->second;
-    if (info == nullptr) {
+  for (const auto &branch_count : maps.branch_counts) {
+    if (!inst_map.Contains(branch_count.first.first)) {
       continue;
     }
     const std::string *callee =
@@ -153,13 +223,13 @@ void Profile::ProcessPerFunctionProfile(std::string func_name,
     }
     if (symbol_map_->map().count(*callee)) {
       symbol_map_->AddSymbolEntryCount(*callee, branch_count.second);
-      symbol_map_->AddIndirectCallTarget(func_name, info->source_stack, *callee,
-                                         branch_count.second,
-                                         SymbolMap::PERFDATA);
+      symbol_map_->AddIndirectCallTarget(
+          func_name, inst_map.GetSourceStack(branch_count.first.first),
+          *callee, branch_count.second, SymbolMap::PERFDATA);
     }
   }
 
-  for (const auto &addr_count : *map_ptr) {
+  for (const auto &addr_count : *counts) {
     global_addr_count_map_[addr_count.first] = addr_count.second;
   }
 }
@@ -175,7 +245,7 @@ void Profile::ComputeProfile() {
       const auto &maps = *symbol_profile.second;
 
       std::map<uint64_t, uint64_t> counts;
-      for (const auto &address_count : maps.address_count_map) {
+      for (const auto &address_count : maps.address_counts) {
         auto pc = address_count.first;
         DCHECK(maps.start_addr <= pc && pc <= maps.end_addr);
         if (!symbol_map_->EnsureEntryInFuncForSymbol(func_name, pc))
@@ -183,7 +253,7 @@ void Profile::ComputeProfile() {
         counts[pc] += address_count.second;
       }
 
-      CHECK(maps.branch_count_map.empty());
+      CHECK(maps.branch_counts.empty());
       for (const auto pair : counts) {
         uint64_t pc = pair.first;
         uint64_t count = pair.second;
@@ -203,6 +273,13 @@ void Profile::ComputeProfile() {
       symbol_counts[absl::StripSuffix(name, ".cold")] +=
           profile->GetAggregatedCount();
     }
+    // The part of an emitted function that has no samples is still emitted.
+    for (const auto &[name, count] : symbol_counts) {
+      if (symbol_map_->ShouldEmit(count)) {
+        AddProfileMapsForSymbol(std::string(name));
+        AddProfileMapsForSymbol(absl::StrCat(name, ".cold"));
+      }
+    }
 
     // First add all symbols that needs to be outputted to the symbol_map_. We
     // need to do this before hand because ProcessPerFunctionProfile will call
@@ -9,10 +9,14 @@
 #include <cstdint>
 #include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "base/integral_types.h"
 #include "base/macros.h"
+#include "function_address_table.h"
 #include "sample_reader.h"
+#include "third_party/abseil/absl/container/flat_hash_map.h"
 #include "third_party/abseil/absl/container/node_hash_map.h"
 
 namespace devtools_crosstool_autofdo {
@@ -43,27 +47,40 @@ class Profile {
   void ComputeProfile();
 
  private:
-  // Internal data structure that aggregates profile for each symbol.
+  // Internal data structure that aggregates profile for each symbol. Each
+  // sample map is split by function in address order, so the counts are
+  // sorted by (source) address and appended without lookups.
   struct ProfileMaps {
     ProfileMaps(uint64_t start, uint64_t end)
         : start_addr(start), end_addr(end) {}
     uint64_t GetAggregatedCount() const;
     uint64_t start_addr;
     uint64_t end_addr;
-    AddressCountMap address_count_map;
-    RangeCountMap range_count_map;
-    BranchCountMap branch_count_map;
+    std::vector<std::pair<uint64_t, uint64_t>> address_counts;
+    std::vector<std::pair<Range, uint64_t>> range_counts;
+    std::vector<std::pair<Branch, uint64_t>> branch_counts;
   };
   typedef absl::node_hash_map<std::string, ProfileMaps *> SymbolProfileMaps;
 
-  // Returns the profile maps for a give function.
-  ProfileMaps *GetProfileMaps(uint64_t addr);
+  // Returns the profile maps for the function containing ADDR, resolving it
+  // with LOOKUP. Returns nullptr if no function contains ADDR.
+  ProfileMaps *GetProfileMaps(FunctionAddressTable::SortedLookup *lookup,
+                              uint64_t addr);
 
-  // Aggregates raw profile for each symbol.
+  // Returns the profile maps for the I-th function of the symbol map's
+  // function address table, creating them if needed.
+  ProfileMaps *GetProfileMapsForFunction(size_t i);
+
+  // Creates empty profile maps for the function named NAME if it has none,
+  // so that it is emitted along with the other part of a split function.
+  void AddProfileMapsForSymbol(const std::string &name);
+
+  // Aggregates raw profile for each sampled symbol.
   void AggregatePerFunctionProfile();
 
   // Builds function level profile for specified function:
-  //   1. Traverses all instructions to build instruction map.
+  //   1. Traverses all instructions to build instruction map, or only the
+  //      sampled ones with --sparse_instruction_map.
   //   2. Unwinds the inline stack to add symbol count to each inlined symbol.
   void ProcessPerFunctionProfile(std::string func_name, const ProfileMaps &map);
 
@@ -72,7 +89,16 @@ class Profile {
   Addr2line *addr2line_;
   SymbolMap *symbol_map_;
   AddressCountMap global_addr_count_map_;
+  // Only the sampled functions, and the other part of those that are split
+  // in hot and cold parts, have profile maps.
   SymbolProfileMaps symbol_profile_maps_;
+  // The symbol_profile_maps_ entries by index in the function address table,
+  // so that per-sample lookups do not hash the function name.
+  absl::flat_hash_map<size_t, ProfileMaps *> function_profile_maps_;
+  // The function whose profile maps were last returned, which most samples
+  // fall into since they come in address order.
+  size_t last_function_ = FunctionAddressTable::kNotFound;
+  ProfileMaps *last_profile_maps_ = nullptr;
 
   DISALLOW_COPY_AND_ASSIGN(Profile);
 };
@@ -7,13 +7,16 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
+#include <numeric>
 
 #include "base/commandlineflags.h"
 #include "base/integral_types.h"
 #include "base/logging.h"
 #include "addr2line.h"
+#include "function_address_table.h"
 #include "gcov.h"
 #if defined(HAVE_LLVM)
 #include "llvm_profile_writer.h"
@@ -185,6 +188,11 @@ bool ProfileCreator::ReadSample(const std::string &input_profile_name,
   return true;
 }
 bool ProfileCreator::ComputeProfile(SymbolMap *symbol_map) {
+  const std::string &kernel_reference_symbol =
+      sample_reader_->kernel_reference_symbol();
+  if (!kernel_reference_symbol.empty() &&
+      !symbol_map->SetBaseAddrToSymbol(kernel_reference_symbol))
+    return false;
   std::set<uint64_t> sampled_addrs = sample_reader_->GetSampledAddresses();
   std::map<uint64_t, uint64_t> sampled_functions =
       symbol_map->GetSampledSymbolStartAddressSizeMap(sampled_addrs);
@@ -207,15 +215,32 @@ bool ProfileCreator::ConvertPrefetchHints(const std::string &profile_file,
   if (!CheckAndAssignAddr2Line(symbol_map, Addr2line::Create(binary_)))
     return false;
   PrefetchHints hints = ReadPrefetchHints(profile_file);
+
+  // Resolve the function of every hint with one forward scan over the
+  // address-sorted hints. The hints themselves are still processed in file
+  // order below.
+  const FunctionAddressTable &functions = symbol_map->function_address_table();
+  std::vector<size_t> order(hints.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&hints](size_t a, size_t b) {
+    return hints[a].address < hints[b].address;
+  });
+  std::vector<size_t> function_index(hints.size());
+  FunctionAddressTable::SortedLookup lookup(functions);
+  for (size_t i : order) {
+    function_index[i] = lookup.Find(hints[i].address);
+  }
+
   std::map<uint64_t, uint8_t> repeated_prefetches_indices;
-  for (auto &hint : hints) {
+  for (size_t i = 0; i < hints.size(); ++i) {
+    const PrefetchHint &hint = hints[i];
     uint64_t pc = hint.address;
     int64_t delta = hint.delta;
-    const std::string *name = nullptr;
-    if (!symbol_map->GetSymbolInfoByAddr(pc, &name, nullptr, nullptr)) {
+    if (function_index[i] == FunctionAddressTable::kNotFound) {
       LOG(INFO) << "Instruction address not found:" << std::hex << pc;
       continue;
     }
+    const std::string *name = &functions.name(function_index[i]);
     uint8_t prefetch_index = repeated_prefetches_indices[pc]++;
 
     SourceStack stack;
@@ -15,7 +15,6 @@
 #include "profile_writer.h"
 #include "symbol_map.h"
 #include "third_party/abseil/absl/base/macros.h"
-#include "third_party/abseil/absl/container/node_hash_set.h"
 #include "third_party/abseil/absl/flags/flag.h"
 #include "third_party/abseil/absl/memory/memory.h"
 #include "llvm/Config/llvm-config.h"
@@ -62,6 +61,9 @@ ABSL_FLAG(bool, split_layout, false,
 ABSL_FLAG(std::string, strip_symbols_regex, "",
           "Strip outline symbols "
           "matching the regular expression in the merged profile. ");
+ABSL_FLAG(int32_t, read_threads, 0,
+          "Number of threads that add the functions of each LLVM profile "
+          "to the merged profile. 0 means one per CPU.");
 
 namespace {
 // Some sepcial symbols or symbol patterns we are going to handle.
@@ -147,8 +149,6 @@ int main(int argc, char **argv) {
       strip_all, ABSL_ARRAYSIZE(strip_all), keep_sole,
       ABSL_ARRAYSIZE(keep_sole), keep_cold, ABSL_ARRAYSIZE(keep_cold));
 
-  absl::node_hash_set<std::string> names;
-
   if (!absl::GetFlag(FLAGS_is_llvm)) {
     using devtools_crosstool_autofdo::AutoFDOProfileReader;
     typedef std::unique_ptr<AutoFDOProfileReader> AutoFDOProfileReaderPtr;
@@ -178,8 +178,9 @@ int main(int argc, char **argv) {
 
     for (int i = 1; i < argc; i++) {
       auto reader = absl::make_unique<LLVMProfileReader>(
-          &symbol_map, names,
+          &symbol_map,
           absl::GetFlag(FLAGS_merge_special_syms) ? nullptr : &special_syms);
+      reader->set_num_threads(absl::GetFlag(FLAGS_read_threads));
       reader->ReadFromFile(argv[i]);
 
       if (absl::GetFlag(FLAGS_include_symbol_list) &&
@@ -37,7 +37,7 @@ void AutoFDOProfileReader::ReadSymbolProfile(const SourceStack &stack,
   } else {
     head_count = 0;
   }
-  const char *name = names_.at(gcov_read_unsigned()).c_str();
+  const char *name = names_.at(gcov_read_unsigned());
   uint32_t num_pos_counts = gcov_read_unsigned();
   uint32_t num_callsites = gcov_read_unsigned();
   if (stack.size() == 0) {
@@ -64,7 +64,7 @@ void AutoFDOProfileReader::ReadSymbolProfile(const SourceStack &stack,
     for (int j = 0; j < num_targets; j++) {
       // Only indirect call target histogram is supported now.
       CHECK_EQ(gcov_read_unsigned(), HIST_TYPE_INDIR_CALL_TOPN);
-      const std::string &target_name = names_.at(gcov_read_counter());
+      const char *target_name = names_.at(gcov_read_counter());
       uint64_t target_count = gcov_read_counter();
       if (force_update_ || update) {
         symbol_map_->AddIndirectCallTarget(
@@ -91,7 +91,7 @@ void AutoFDOProfileReader::ReadNameTable() {
   gcov_read_unsigned();
   uint32_t name_vector_size = gcov_read_unsigned();
   for (uint32_t i = 0; i < name_vector_size; i++) {
-    names_.push_back(gcov_read_string());
+    names_.push_back(FunctionNameTable::Intern(gcov_read_string()).data());
   }
 }
 
@@ -57,7 +57,8 @@ class AutoFDOProfileReader : public ProfileReader {
 
   SymbolMap *symbol_map_;
   bool force_update_;
-  std::vector<std::string> names_;
+  // The name table of the profile, interned in FunctionNameTable.
+  std::vector<const char *> names_;
 };
 
 }  // namespace devtools_crosstool_autofdo
@@ -0,0 +1,82 @@
+// These tests check the source level profile built from the samples of
+// a binary.
+
+#include "profile.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "profile_creator.h"
+#include "profile_writer.h"
+#include "gtest/gtest.h"
+#include "third_party/abseil/absl/flags/flag.h"
+#include "third_party/abseil/absl/strings/str_cat.h"
+
+ABSL_DECLARE_FLAG(bool, sparse_instruction_map);
+ABSL_DECLARE_FLAG(bool, use_lbr);
+ABSL_DECLARE_FLAG(uint64_t, gcov_version);
+
+#define FLAGS_test_tmpdir std::string(testing::UnitTest::GetInstance()->original_working_dir())
+
+#define FLAGS_test_srcdir std::string(testing::UnitTest::GetInstance()->original_working_dir())
+
+namespace {
+
+using ::devtools_crosstool_autofdo::AutoFDOProfileWriter;
+using ::devtools_crosstool_autofdo::ProfileCreator;
+
+// Writes the gcov profile of BINARY built from the samples in PROFILE to
+// OUTPUT, and returns its contents. The profile includes the working sets,
+// which are computed from the instruction counts.
+std::string CreateGcovProfile(const std::string &binary,
+                              const std::string &profile,
+                              const std::string &output) {
+  ProfileCreator creator(binary);
+  AutoFDOProfileWriter writer(absl::GetFlag(FLAGS_gcov_version));
+  if (!creator.CreateProfile(profile, "perf", &writer, output)) return "";
+  std::ifstream in(output, std::ios::binary);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+// The sparse instruction map only stores the source stacks of the sampled
+// instructions, but must add the same counts to the symbol map as the dense
+// one, down to the zero counts of unsampled lines and the instruction
+// counts.
+TEST(ProfileTest, SparseInstructionMapMatchesDense) {
+  const struct {
+    const char *binary;
+    const char *profile;
+  } kTestCases[] = {
+      {"test.binary", "test.lbr"},
+      {"libro_sample.so", "ro_sample.perf"},
+      {"propeller_sample.bin", "propeller_sample.perfdata"},
+      {"propeller_sample_1.bin", "propeller_sample_1.perfdata1"},
+  };
+  for (const auto &test_case : kTestCases) {
+    for (bool use_lbr : {true, false}) {
+      SCOPED_TRACE(absl::StrCat(test_case.binary, " ", test_case.profile,
+                                use_lbr ? " with LBR" : " without LBR"));
+      const std::string binary =
+          FLAGS_test_srcdir + "/testdata/" + test_case.binary;
+      const std::string profile =
+          FLAGS_test_srcdir + "/testdata/" + test_case.profile;
+      const std::string output =
+          FLAGS_test_tmpdir + "/" + test_case.binary + ".afdo";
+      absl::SetFlag(&FLAGS_use_lbr, use_lbr);
+
+      absl::SetFlag(&FLAGS_sparse_instruction_map, false);
+      const std::string dense = CreateGcovProfile(binary, profile, output);
+      absl::SetFlag(&FLAGS_sparse_instruction_map, true);
+      const std::string sparse = CreateGcovProfile(binary, profile, output);
+
+      ASSERT_FALSE(dense.empty());
+      EXPECT_TRUE(dense == sparse);
+    }
+  }
+  absl::SetFlag(&FLAGS_sparse_instruction_map, false);
+  absl::SetFlag(&FLAGS_use_lbr, true);
+}
+}  // namespace
@@ -23,6 +23,7 @@
 #include "symbol_map.h"
 #include "third_party/abseil/absl/flags/flag.h"
 #include "third_party/abseil/absl/strings/str_format.h"
+#include "third_party/abseil/absl/strings/string_view.h"
 
 // sizeof(gcov_unsigned_t)
 #define SIZEOF_UNSIGNED 4
@@ -103,12 +104,18 @@ class SourceProfileWriter: public SymbolTraverser {
       gcov_write_unsigned(SourceInfo::GenerateCompressedOffset(value));
       gcov_write_unsigned(pos_count.second.target_map.size());
       gcov_write_counter(pos_count.second.count);
-      TargetCountPairs target_counts;
-      GetSortedTargetCountPairs(pos_count.second.target_map, &target_counts);
+      // The string table is sorted, so the targets are written by name.
+      std::vector<std::pair<int, uint64_t>> index_counts;
+      index_counts.reserve(pos_count.second.target_map.size());
       for (const auto &target_count : pos_count.second.target_map) {
+        index_counts.emplace_back(GetStringIndex(target_count.first),
+                                  target_count.second);
+      }
+      std::sort(index_counts.begin(), index_counts.end());
+      for (const auto &index_count : index_counts) {
         gcov_write_unsigned(HIST_TYPE_INDIR_CALL_TOPN);
-        gcov_write_counter(GetStringIndex(target_count.first));
-        gcov_write_counter(target_count.second);
+        gcov_write_counter(index_count.first);
+        gcov_write_counter(index_count.second);
       }
     }
   }
@@ -127,29 +134,37 @@ class SourceProfileWriter: public SymbolTraverser {
  private:
   explicit SourceProfileWriter(const StringIndexMap &map) : map_(map) {}
 
-  int GetStringIndex(const std::string &str) {
-    StringIndexMap::const_iterator ret = map_.find(str);
+  int GetStringIndex(uint32_t id) {
+    StringIndexMap::const_iterator ret = map_.find(id);
     CHECK(ret != map_.end());
     return ret->second;
   }
+  int GetStringIndex(absl::string_view str) {
+    return GetStringIndex(FunctionNameTable::Id(str));
+  }
 
   const StringIndexMap &map_;
   DISALLOW_COPY_AND_ASSIGN(SourceProfileWriter);
 };
 
 void AutoFDOProfileWriter::WriteFunctionProfile() {
-  typedef std::map<std::string, int> StringIndexMap;
-  // Map from a string to its index in this map. Providing a partial
-  // ordering of all output strings.
+  // Map from a string to its index in the string table, in which the
+  // strings are sorted.
   StringIndexMap string_index_map;
   int length_4bytes = 0, current_name_index = 0;
-  string_index_map[std::string()] = 0;
+  string_index_map[FunctionNameTable::Id("")] = 0;
 
   StringTableUpdater::Update(*symbol_map_, &string_index_map);
 
-  for (auto &name_index : string_index_map) {
-    name_index.second = current_name_index++;
-    length_4bytes += (name_index.first.size()
+  std::vector<std::pair<absl::string_view, uint32_t>> names;
+  names.reserve(string_index_map.size());
+  for (const auto &id_index : string_index_map) {
+    names.emplace_back(FunctionNameTable::Name(id_index.first), id_index.first);
+  }
+  std::sort(names.begin(), names.end());
+  for (const auto &name_id : names) {
+    string_index_map[name_id.second] = current_name_index++;
+    length_4bytes += (name_id.first.size()
                       + SIZEOF_UNSIGNED) / SIZEOF_UNSIGNED;
     length_4bytes += 1;
   }
@@ -159,8 +174,9 @@ void AutoFDOProfileWriter::WriteFunctionProfile() {
   gcov_write_unsigned(GCOV_TAG_AFDO_FILE_NAMES);
   gcov_write_unsigned(length_4bytes);
   gcov_write_unsigned(string_index_map.size());
-  for (const auto &name_index : string_index_map) {
-    char *c = strdup(name_index.first.c_str());
+  for (const auto &name_id : names) {
+    // The interned names are NUL-terminated.
+    char *c = strdup(name_id.first.data());
     int len = strlen(c);
     // Workaround https://gcc.gnu.org/bugzilla/show_bug.cgi?id=64346
     // We should not have D4Ev in our profile because it does not exist
@@ -231,9 +247,10 @@ class ProfileDumper : public SymbolTraverser {
 
  protected:
   void DumpSourceInfo(SourceInfo info, int indent) {
-    printf("%*sDirectory name: %s\n", indent, " ", info.dir_name.c_str());
-    printf("%*sFile name:      %s\n", indent, " ",
-           info.file_name.c_str());
+    printf("%*sDirectory name: %.*s\n", indent, " ",
+           static_cast<int>(info.dir_name.size()), info.dir_name.data());
+    printf("%*sFile name:      %.*s\n", indent, " ",
+           static_cast<int>(info.file_name.size()), info.file_name.data());
     printf("%*sFunction name:  %s\n", indent, " ", info.func_name);
     printf("%*sStart line:     %u\n", indent, " ", info.start_line);
     printf("%*sLine:           %u\n", indent, " ", info.line);
@@ -298,11 +315,11 @@ class ProfileDumper : public SymbolTraverser {
       absl::PrintF("#%d: profile info number of instructions = %u\n", i,
                    info.num_inst);
       TargetCountPairs target_counts;
-      GetSortedTargetCountPairs(info.target_map, &target_counts);
+      GetTargetCountPairsByName(info.target_map, &target_counts);
       absl::PrintF("#%d: profile info target map size = %u\n", i,
                    static_cast<uint64_t>(info.target_map.size()));
       printf("#%d: info.target_map:\n", i);
-      for (const auto &target_count : info.target_map) {
+      for (const auto &target_count : target_counts) {
         printf("\tGetStringIndex(target_count.first): %d\n",
                GetStringIndex(target_count.first));
         absl::PrintF("\ttarget_count.second: %u\n", target_count.second);
@@ -324,14 +341,15 @@ class ProfileDumper : public SymbolTraverser {
     printf("VisitCallSite: %s\n", callsite.second);
     printf("callsite.first: %lu\n", callsite.first);
     printf("GetStringIndex(callsite.second): %u\n",
-           GetStringIndex(callsite.second ? callsite.second : std::string()));
+           GetStringIndex(callsite.second ? callsite.second : ""));
   }
 
  private:
   explicit ProfileDumper(const StringIndexMap &map) : map_(map) {}
 
-  int GetStringIndex(const std::string &str) {
-    StringIndexMap::const_iterator ret = map_.find(str);
+  int GetStringIndex(absl::string_view str) {
+    StringIndexMap::const_iterator ret =
+        map_.find(FunctionNameTable::Id(str));
     CHECK(ret != map_.end());
     return ret->second;
   }
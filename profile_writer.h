@@ -7,8 +7,12 @@
 #define AUTOFDO_PROFILE_WRITER_H_
 
 #include <cstdint>
+#include <string>
 
+#include "source_info.h"
 #include "symbol_map.h"
+#include "third_party/abseil/absl/container/flat_hash_map.h"
+#include "third_party/abseil/absl/strings/string_view.h"
 
 namespace devtools_crosstool_autofdo {
 
@@ -142,7 +146,9 @@ class SymbolTraverser {
   DISALLOW_COPY_AND_ASSIGN(SymbolTraverser);
 };
 
-typedef std::map<std::string, int> StringIndexMap;
+// Map from the FunctionNameTable id of a string to its index in the string
+// table. The strings are only looked up when the table is written.
+typedef absl::flat_hash_map<uint32_t, int> StringIndexMap;
 
 class StringTableUpdater: public SymbolTraverser {
  public:
@@ -155,21 +161,25 @@ class StringTableUpdater: public SymbolTraverser {
   void Visit(const Symbol *node) override {
     for (const auto &pos_count : node->pos_counts) {
       for (const auto &name_count : pos_count.second.target_map) {
-        (*map_)[name_count.first] = 0;
+        Add(name_count.first);
       }
     }
   }
 
   void VisitCallsite(const Callsite &callsite) {
-    (*map_)[Symbol::Name(callsite.second)] = 0;
+    Add(Symbol::Name(callsite.second));
   }
 
   void VisitTopSymbol(const std::string &name, const Symbol *node) override {
-    (*map_)[Symbol::Name(name.c_str())] = 0;
+    Add(Symbol::Name(name.c_str()));
   }
 
  private:
   explicit StringTableUpdater(StringIndexMap *map) : map_(map) {}
+
+  void Add(uint32_t id) { map_->emplace(id, 0); }
+  void Add(absl::string_view name) { Add(FunctionNameTable::Id(name)); }
+
   StringIndexMap *map_;
   DISALLOW_COPY_AND_ASSIGN(StringTableUpdater);
 };
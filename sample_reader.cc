@@ -8,6 +8,7 @@
 #include <inttypes.h>
 
 #include <cstdint>
+#include <cstring>
 #include <list>
 #include <memory>
 #include <set>
@@ -18,6 +19,8 @@
 #include "base/logging.h"
 #include "base/port.h"
 #include "third_party/abseil/absl/flags/flag.h"
+#include "third_party/abseil/absl/strings/match.h"
+#include "third_party/abseil/absl/strings/str_cat.h"
 #include "third_party/abseil/absl/strings/str_format.h"
 #include "third_party/abseil/absl/strings/str_join.h"
 #include "quipper/perf_parser.h"
@@ -27,6 +30,32 @@ ABSL_FLAG(uint64_t, strip_dup_backedge_stride_limit, 0x1000,
           "Controls the limit of backedge stride hold by the heuristic "
           "to strip duplicated entries in LBR stack. ");
 
+namespace {
+// Perf names the mapping of the kernel image after it.
+const char kKernelName[] = "[kernel.kallsyms]";
+
+// Finds the mapping of the kernel image in the events of PARSER. Perf names
+// it after the symbol it is relative to, e.g. "[kernel.kallsyms]_text", and
+// records the runtime address of that symbol, which includes the KASLR
+// offset, as its page offset.
+bool FindKernelMapping(const quipper::PerfParser &parser,
+                       std::string *reference_symbol,
+                       uint64_t *reference_addr) {
+  for (const auto &event : parser.parsed_events()) {
+    if (!event.event_ptr || !event.event_ptr->has_mmap_event()) continue;
+    const auto &mmap = event.event_ptr->mmap_event();
+    if (!absl::StartsWith(mmap.filename(), kKernelName) ||
+        mmap.filename().size() == strlen(kKernelName)) {
+      continue;
+    }
+    *reference_symbol = mmap.filename().substr(strlen(kKernelName));
+    *reference_addr = mmap.pgoff();
+    return true;
+  }
+  return false;
+}
+}  // namespace
+
 namespace devtools_crosstool_autofdo {
 
 PerfDataSampleReader::PerfDataSampleReader(const std::string &profile_file,
@@ -72,9 +101,9 @@ void PerfDataSampleReader::GetFileNameFromBuildID(const quipper::PerfReader*
           (name_buildid.first.size() >= vmlinux_len &&
            !name_buildid.first.compare(name_buildid.first.size() - vmlinux_len,
                                        vmlinux_len, "vmlinux"))) {
-        focus_bins_.insert("[kernel.kallsyms]");
-        focus_bins_.insert("[kernel.kallsyms]_stext");
-        focus_bins_.insert("[kernel.kallsyms]_text");
+        focus_bins_.insert(kKernelName);
+        focus_bins_.insert(absl::StrCat(kKernelName, "_stext"));
+        focus_bins_.insert(absl::StrCat(kKernelName, "_text"));
       } else {
         focus_bins_.insert(name_buildid.first);
       }
@@ -272,19 +301,41 @@ bool PerfDataSampleReader::Append(const std::string &profile_file) {
     LOG(ERROR) << "No buildid found in binary";
   }
 
+  // Kernel samples are made relative to the kernel's reference symbol, so
+  // that they do not depend on where KASLR placed the kernel. Other samples
+  // are offsets in their binary's mapping.
+  const bool is_kernel = focus_bins_.count(kKernelName) > 0;
+  uint64_t kernel_base = 0;
+  if (is_kernel &&
+      !FindKernelMapping(parser, &kernel_reference_symbol_, &kernel_base)) {
+    LOG(ERROR) << "Cannot find the kernel mapping in " << profile_file;
+    return false;
+  }
+
   for (const auto &event : parser.parsed_events()) {
     if (!event.event_ptr ||
         event.event_ptr->header().type() != quipper::PERF_RECORD_SAMPLE) {
       continue;
     }
+    const auto &sample = event.event_ptr->sample_event();
+    // The parsed branch stack is the prefix of the recorded one that has
+    // non-null entries.
+    auto from = [&](int i) {
+      return is_kernel ? sample.branch_stack(i).from_ip() - kernel_base
+                       : event.branch_stack[i].from.offset();
+    };
+    auto to = [&](int i) {
+      return is_kernel ? sample.branch_stack(i).to_ip() - kernel_base
+                       : event.branch_stack[i].to.offset();
+    };
     if (MatchBinary(event.dso_and_offset.dso_name())) {
-      address_count_map_[event.dso_and_offset.offset()]++;
+      address_count_map_[is_kernel ? sample.ip() - kernel_base
+                                   : event.dso_and_offset.offset()]++;
     }
     if (event.branch_stack.size() > 0 &&
         MatchBinary(event.branch_stack[0].to.dso_name()) &&
         MatchBinary(event.branch_stack[0].from.dso_name())) {
-      branch_count_map_[Branch(event.branch_stack[0].from.offset(),
-                               event.branch_stack[0].to.offset())]++;
+      branch_count_map_[Branch(from(0), to(0))]++;
     }
     for (int i = 1; i < event.branch_stack.size(); i++) {
       if (!MatchBinary(event.branch_stack[i].to.dso_name())) {
@@ -298,17 +349,12 @@ bool PerfDataSampleReader::Append(const std::string &profile_file) {
       // blocks larger than 0x1000 formed by such self loop. So, we're ignoring
       // duplication when the resulting basic block is larger than 0x1000 (the
       // default value of FLAGS_strip_dup_backedge_stride_limit).
-      if (i == 1 &&
-          (event.branch_stack[0].from.offset() ==
-           event.branch_stack[1].from.offset()) &&
-          (event.branch_stack[0].to.offset() ==
-           event.branch_stack[1].to.offset()) &&
-          (event.branch_stack[0].from.offset() -
-               event.branch_stack[0].to.offset() >
+      if (i == 1 && from(0) == from(1) && to(0) == to(1) &&
+          (from(0) - to(0) >
            absl::GetFlag(FLAGS_strip_dup_backedge_stride_limit)))
         continue;
-      uint64_t begin = event.branch_stack[i].to.offset();
-      uint64_t end = event.branch_stack[i - 1].from.offset();
+      uint64_t begin = to(i);
+      uint64_t end = from(i - 1);
       // The interval between two taken branches should not be too large.
       if (end < begin || end - begin > (1 << 20)) {
         LOG(WARNING) << "Bogus LBR data: " << begin << "->" << end;
@@ -316,8 +362,7 @@ bool PerfDataSampleReader::Append(const std::string &profile_file) {
       }
       range_count_map_[Range(begin, end)]++;
       if (MatchBinary(event.branch_stack[i].from.dso_name())) {
-        branch_count_map_[Branch(event.branch_stack[i].from.offset(),
-                                 event.branch_stack[i].to.offset())]++;
+        branch_count_map_[Branch(from(i), to(i))]++;
       }
     }
   }
@@ -63,6 +63,11 @@ class SampleReader {
   uint64_t GetTotalSampleCount() const;
   // Returns the max count.
   uint64_t GetTotalCount() const { return total_count_; }
+  // Returns the symbol that the sampled addresses are relative to when they
+  // are from a Linux kernel image, e.g. "_text", or "" otherwise.
+  const std::string &kernel_reference_symbol() const {
+    return kernel_reference_symbol_;
+  }
   // Clear all maps to release memory.
   void Clear() {
     address_count_map_.clear();
@@ -75,6 +80,7 @@ class SampleReader {
   virtual bool Read() = 0;
 
   uint64_t total_count_;
+  std::string kernel_reference_symbol_;
   AddressCountMap address_count_map_;
   RangeCountMap range_count_map_;
   BranchCountMap branch_count_map_;
@@ -45,6 +45,7 @@ TEST_F(SampleReaderTest, ReadPerf) {
   EXPECT_EQ(reader.GetSampleCountOrZero(0xfe0), 238);
   EXPECT_EQ(reader.GetSampleCountOrZero(0x1005), 87);
   EXPECT_EQ(reader.GetTotalCount(), 79874);
+  EXPECT_TRUE(reader.kernel_reference_symbol().empty());
 }
 
 TEST_F(SampleReaderTest, ReadLBR) {
@@ -120,6 +121,12 @@ TEST_F(SampleReaderTest, ReadKernelKallsymsProfile) {
       profile, ".*/vmlinux", "d4eba24dde8ec63cbdf519e6b4008c4ecdcf1f49");
   ASSERT_TRUE(reader.ReadAndSetTotalCount());
   EXPECT_EQ(reader.GetTotalSampleCount(), 1421);
+
+  // The samples are relative to _stext, so they fall within the size of the
+  // kernel mapping whatever the KASLR offset.
+  EXPECT_EQ(reader.kernel_reference_symbol(), "_stext");
+  ASSERT_FALSE(reader.address_count_map().empty());
+  EXPECT_LT(reader.address_count_map().rbegin()->first, 0xb7f800);
 }
 
 TEST_F(SampleReaderTest, ReadVmlinuxProfile) {
@@ -134,5 +141,6 @@ TEST_F(SampleReaderTest, ReadVmlinuxProfile) {
       profile, ".*/vmlinux", "948da3c05fff6a515eab7b9dd416e30564b2ccf2");
   ASSERT_TRUE(reader.ReadAndSetTotalCount());
   EXPECT_EQ(reader.GetTotalSampleCount(), 1936);
+  EXPECT_FALSE(reader.kernel_reference_symbol().empty());
 }
 }  // namespace
@@ -2,10 +2,133 @@
 
 #include "source_info.h"
 
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "base/logging.h"
-#include "llvm/ADT/StringRef.h"
+#include "third_party/abseil/absl/container/flat_hash_map.h"
+#include "third_party/abseil/absl/container/flat_hash_set.h"
+#include "third_party/abseil/absl/hash/hash.h"
 
 namespace {
+// Size of each arena block backing SourcePathTable and FunctionNameTable.
+// Strings longer than this get a block of their own.
+constexpr size_t kStringArenaBlockSize = 64 * 1024;
+
+// Append-only storage for strings. Not thread-safe.
+class StringArena {
+ public:
+  StringArena() : cur_(nullptr), remaining_(0) {}
+
+  // Copies STR into the arena with a trailing NUL.
+  absl::string_view Copy(absl::string_view str) {
+    size_t needed = str.size() + 1;
+    if (needed > remaining_) {
+      size_t block_size = std::max(needed, kStringArenaBlockSize);
+      blocks_.emplace_back(new char[block_size]);
+      cur_ = blocks_.back().get();
+      remaining_ = block_size;
+    }
+    char *dest = cur_;
+    memcpy(dest, str.data(), str.size());
+    dest[str.size()] = '\0';
+    cur_ += needed;
+    remaining_ -= needed;
+    return absl::string_view(dest, str.size());
+  }
+
+ private:
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char *cur_;
+  size_t remaining_;
+};
+
+// Set of interned strings. Thread-safe.
+class StringTable {
+ public:
+  absl::string_view Intern(absl::string_view str) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = strings_.find(str);
+    if (iter != strings_.end()) return *iter;
+    absl::string_view copy = arena_.Copy(str);
+    strings_.insert(copy);
+    return copy;
+  }
+
+ private:
+  std::mutex mutex_;
+  absl::flat_hash_set<absl::string_view> strings_;
+  StringArena arena_;
+};
+
+// Interned strings numbered in the order they are first seen, starting with
+// the empty string as 0. Thread-safe.
+class NumberedStringTable {
+ public:
+  NumberedStringTable() { Add(""); }
+
+  uint32_t Id(absl::string_view str) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return IdLocked(str);
+  }
+
+  absl::string_view Intern(absl::string_view str) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_[IdLocked(str)].str;
+  }
+
+  bool Find(absl::string_view str, uint32_t *id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = ids_.find(str);
+    if (iter == ids_.end()) return false;
+    *id = iter->second;
+    return true;
+  }
+
+  absl::string_view Get(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK_LT(id, entries_.size());
+    return entries_[id].str;
+  }
+
+  size_t Hash(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK_LT(id, entries_.size());
+    return entries_[id].hash;
+  }
+
+ private:
+  struct Entry {
+    absl::string_view str;
+    size_t hash;
+  };
+
+  uint32_t IdLocked(absl::string_view str) {
+    auto iter = ids_.find(str);
+    if (iter != ids_.end()) return iter->second;
+    return Add(str);
+  }
+
+  uint32_t Add(absl::string_view str) {
+    CHECK_LT(entries_.size(), std::numeric_limits<uint32_t>::max());
+    const uint32_t id = entries_.size();
+    absl::string_view copy = str.empty() ? "" : arena_.Copy(str);
+    entries_.push_back({copy, absl::Hash<absl::string_view>()(copy)});
+    ids_.emplace(copy, id);
+    return id;
+  }
+
+  std::mutex mutex_;
+  absl::flat_hash_map<absl::string_view, uint32_t> ids_;
+  std::deque<Entry> entries_;  // Indexed by id.
+  StringArena arena_;
+};
+
 int StrcmpMaybeNull(const char *a, const char *b) {
   if (a == nullptr) {
     a = "";
@@ -15,6 +138,13 @@ int StrcmpMaybeNull(const char *a, const char *b) {
   }
   return strcmp(a, b);
 }
+
+// Returns the process-wide table of function names. Intentionally leaked,
+// like the source paths.
+NumberedStringTable *GetFunctionNames() {
+  static NumberedStringTable *names = new NumberedStringTable();
+  return names;
+}
 }  // namespace
 
 namespace devtools_crosstool_autofdo {
@@ -23,6 +153,35 @@ namespace devtools_crosstool_autofdo {
 bool SourceInfo::use_fs_discriminator = false;
 #endif
 
+absl::string_view SourcePathTable::Intern(absl::string_view str) {
+  if (str.empty()) return "";
+  // Intentionally leaked: interned views must outlive every SourceInfo,
+  // including those in static storage.
+  static StringTable *table = new StringTable();
+  return table->Intern(str);
+}
+
+absl::string_view FunctionNameTable::Intern(absl::string_view name) {
+  if (name.empty()) return "";
+  return GetFunctionNames()->Intern(name);
+}
+
+uint32_t FunctionNameTable::Id(absl::string_view name) {
+  return GetFunctionNames()->Id(name);
+}
+
+bool FunctionNameTable::FindId(absl::string_view name, uint32_t *id) {
+  return GetFunctionNames()->Find(name, id);
+}
+
+absl::string_view FunctionNameTable::Name(uint32_t id) {
+  return GetFunctionNames()->Get(id);
+}
+
+size_t FunctionNameTable::Hash(uint32_t id) {
+  return GetFunctionNames()->Hash(id);
+}
+
 bool SourceInfo::operator<(const SourceInfo &p) const {
   if (line != p.line) {
     return line < p.line;
@@ -37,18 +196,12 @@ bool SourceInfo::operator<(const SourceInfo &p) const {
   if (ret != 0) {
     return ret < 0;
   }
-  // The comparison below relies on the lexicographical behavior of
-  // llvm::StringRef::compare. C++ string compare should return the same result,
-  // but since converting to llvm::StringRef is very cheap, and both functions
-  // may not stay in sync, preferring to retain the prior functionality.
-  auto p_file_name_ref = llvm::StringRef(p.file_name);
-  auto file_name_ref = llvm::StringRef(file_name);
-  ret = file_name_ref.compare(p_file_name_ref);
+  // string_view::compare is lexicographical, same as the llvm::StringRef
+  // comparison previously used here.
+  ret = file_name.compare(p.file_name);
   if (ret != 0) {
     return ret < 0;
   }
-  auto p_dir_name_ref = llvm::StringRef(p.dir_name);
-  auto dir_name_ref = llvm::StringRef(dir_name);
-  return dir_name_ref.compare(p_dir_name_ref) < 0;
+  return dir_name.compare(p.dir_name) < 0;
 }
 }  // namespace devtools_crosstool_autofdo
@@ -9,27 +9,66 @@
 
 #include "base/integral_types.h"
 #include "base/macros.h"
+#include "third_party/abseil/absl/strings/string_view.h"
 #if defined(HAVE_LLVM)
 #include "llvm/IR/DebugInfoMetadata.h"
 #endif
 
 namespace devtools_crosstool_autofdo {
 
+// Process-wide table of interned source path strings. File and directory
+// names are shared by every SourceInfo that refers to them, so they are
+// stored once in an append-only arena and never freed. Thread-safe.
+class SourcePathTable {
+ public:
+  // Returns the interned copy of STR. The returned view stays valid for the
+  // lifetime of the process and is always NUL-terminated.
+  static absl::string_view Intern(absl::string_view str);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SourcePathTable);
+};
+
+// Process-wide table of interned function names, such as the call targets of
+// the profiles and the names read by the profile readers. Like source paths,
+// they are stored once in an append-only arena and never freed. Each name
+// also gets a 32-bit id, so that it can be kept and compared as an integer
+// and only turned back into a string when a profile is written. Thread-safe.
+class FunctionNameTable {
+ public:
+  // Returns the interned copy of NAME. The returned view stays valid for the
+  // lifetime of the process and is always NUL-terminated.
+  static absl::string_view Intern(absl::string_view name);
+
+  // Returns the id of NAME, interning it if needed. Ids are given out in the
+  // order the names are first seen and never change; the empty name is 0.
+  static uint32_t Id(absl::string_view name);
+
+  // Sets *ID to the id of NAME and returns true if NAME has one, without
+  // interning it otherwise.
+  static bool FindId(absl::string_view name, uint32_t *id);
+
+  // Returns the interned name of ID, which must have been returned by Id.
+  static absl::string_view Name(uint32_t id);
+
+  // Returns the hash of the mangled name of ID, computed once when it was
+  // interned. It is not stable across runs.
+  static size_t Hash(uint32_t id);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FunctionNameTable);
+};
+
 // Represents the source position.
 struct SourceInfo {
   SourceInfo() : func_name(NULL), start_line(0), line(0), discriminator(0) {}
 
-#if defined(HAVE_LLVM)
-  SourceInfo(const char *func_name, llvm::StringRef dir_name,
-             llvm::StringRef file_name, uint32_t start_line, uint32_t line,
+  SourceInfo(const char *func_name, absl::string_view dir_name,
+             absl::string_view file_name, uint32_t start_line, uint32_t line,
              uint32_t discriminator)
-#else
-  SourceInfo(const char *func_name, std::string dir_name, std::string file_name,
-             uint32_t start_line, uint32_t line, uint32_t discriminator)
-#endif
       : func_name(func_name),
-        dir_name(dir_name),
-        file_name(file_name),
+        dir_name(SourcePathTable::Intern(dir_name)),
+        file_name(SourcePathTable::Intern(file_name)),
         start_line(start_line),
         line(line),
         discriminator(discriminator) {
@@ -39,8 +78,8 @@ struct SourceInfo {
 
   std::string RelativePath() const {
     if (!dir_name.empty())
-      return dir_name + "/" + file_name;
-    if (!file_name.empty()) return file_name;
+      return std::string(dir_name) + "/" + std::string(file_name);
+    if (!file_name.empty()) return std::string(file_name);
     return std::string();
   }
 
@@ -100,8 +139,10 @@ struct SourceInfo {
 #endif
 
   const char *func_name;
-  std::string dir_name;
-  std::string file_name;
+  // Both point into SourcePathTable, so copying a SourceInfo never copies
+  // the path strings themselves.
+  absl::string_view dir_name;
+  absl::string_view file_name;
   uint32_t start_line;
   uint32_t line;
   uint32_t discriminator;
@@ -6,6 +6,10 @@
 #define AUTOFDO_SYMBOL_MAP_H_
 #include <cstdint>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
 #include <set>
 #include <string>
 #include <unordered_set>
@@ -16,11 +20,15 @@
 #include "base/logging.h"
 #include "base/macros.h"
 #include "addr2line.h"
+#include "flat_map.h"
+#include "function_address_table.h"
 #include "source_info.h"
 #include "third_party/abseil/absl/container/flat_hash_map.h"
 #include "third_party/abseil/absl/container/flat_hash_set.h"
 #include "third_party/abseil/absl/container/node_hash_map.h"
 #include "third_party/abseil/absl/flags/declare.h"
+#include "third_party/abseil/absl/strings/string_view.h"
+#include "third_party/abseil/absl/types/span.h"
 
 #if defined(HAVE_LLVM)
 #include "llvm/ProfileData/SampleProf.h"
@@ -39,8 +47,11 @@ ABSL_DECLARE_FLAG(bool, use_fs_discriminator);
 
 namespace devtools_crosstool_autofdo {
 
-typedef std::map<std::string, uint64_t> CallTargetCountMap;
-typedef std::pair<std::string, uint64_t> TargetCountPair;
+// Map from the FunctionNameTable id of a call target to its count, sorted by
+// id. The names are only looked up to report or write the targets.
+typedef FlatMap<uint32_t, uint64_t> CallTargetCountMap;
+// The name of a call target and its count.
+typedef std::pair<absl::string_view, uint64_t> TargetCountPair;
 typedef std::vector<TargetCountPair> TargetCountPairs;
 
 class Addr2line;
@@ -63,6 +74,11 @@ struct gcov_working_set_info {
 void GetSortedTargetCountPairs(const CallTargetCountMap &call_target_count_map,
                                TargetCountPairs *target_counts);
 
+// Same as GetSortedTargetCountPairs, but the pairs are sorted by name, the
+// order in which the writers emit them.
+void GetTargetCountPairsByName(const CallTargetCountMap &call_target_count_map,
+                               TargetCountPairs *target_counts);
+
 // The miminal total samples for a outline symbol to be emitted to the profile.
 const int64_t kMinSamples = 10;
 
@@ -81,8 +97,10 @@ class ProfileInfo {
 // TODO(dehao): deprecate this when old profile format is deprecated.
 typedef std::map<const SourceStack, ProfileInfo> SourceStackCountMap;
 
-// Map from a source location (represented by offset+discriminator) to profile.
-typedef std::map<uint64_t, ProfileInfo> PositionCountMap;
+// Map from a source location (represented by offset+discriminator) to profile,
+// sorted by location. It is on the heap rather than in the SymbolArena, which
+// never reclaims memory, as its vector is regrown while it is filled.
+typedef FlatMap<uint64_t, ProfileInfo> PositionCountMap;
 
 // callsite_location, callee_name
 typedef std::pair<uint64_t, const char *> Callsite;
@@ -96,6 +114,10 @@ struct CallsiteEqual {
   bool operator()(const Callsite& c1, const Callsite& c2) const {
     if (c1.first != c2.first)
       return false;
+    // Names interned in FunctionNameTable, as the profile readers' are, are
+    // equal when their pointers are.
+    if (c1.second == c2.second)
+      return true;
     if ((c1.second == NULL || c2.second == NULL))
       return c1.second == c2.second;
     return strcmp(c1.second, c2.second) == 0;
@@ -103,14 +125,62 @@ struct CallsiteEqual {
 };
 class Symbol;
 class SymbolMap;
-// Map from a callsite to the callee symbol.
-typedef absl::node_hash_map<Callsite, Symbol *, CallsiteHash, CallsiteEqual>
+// Map from a callsite to the callee symbol. It is allocated from the
+// SymbolArena of the caller.
+typedef absl::node_hash_map<
+    Callsite, Symbol *, CallsiteHash, CallsiteEqual,
+    std::pmr::polymorphic_allocator<std::pair<const Callsite, Symbol *>>>
     CallsiteMap;
 // Maps function names to symbols. Symbols are not owned and multiple names can
 // map to the same symbol.
 typedef std::map<std::string, Symbol *> NameSymbolMap;
 
-struct SCCNode;
+// Allocates the symbols of a SymbolMap, and their callsite maps, from large
+// blocks that are all released with the arena. The symbols are destroyed in
+// creation order rather than by walking the inline trees, and the nodes of
+// their maps are not freed one by one. Not thread-safe unless
+// set_thread_safe(true) is called.
+class SymbolArena : public std::pmr::memory_resource {
+ public:
+  SymbolArena() : thread_safe_(false) {}
+  ~SymbolArena() override;
+
+  // Creates a symbol in the arena, passing ARGS to its constructor after the
+  // arena itself.
+  template <typename... Args>
+  Symbol *New(Args &&... args);
+
+  std::pmr::memory_resource *resource() { return this; }
+
+  // Makes New and the allocations of the maps safe to call from several
+  // threads, at the cost of taking a lock for each of them.
+  void set_thread_safe(bool thread_safe) { thread_safe_ = thread_safe; }
+
+ private:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    std::unique_lock<std::mutex> lock = Lock();
+    return blocks_.allocate(bytes, alignment);
+  }
+  // Memory is only released with the arena.
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {}
+  bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  std::unique_lock<std::mutex> Lock() {
+    return thread_safe_ ? std::unique_lock<std::mutex>(mutex_)
+                        : std::unique_lock<std::mutex>();
+  }
+
+  std::pmr::monotonic_buffer_resource blocks_;
+  std::vector<Symbol *> symbols_;
+  std::mutex mutex_;
+  bool thread_safe_;
+
+  DISALLOW_COPY_AND_ASSIGN(SymbolArena);
+};
+
 class CallGraph;
 // Contains information about a specific symbol.
 // There are two types of symbols:
@@ -120,42 +190,37 @@ class CallGraph;
 // 2. Inlined symbol: the symbol is cloned in another function. It does not
 //                    have the begin_address and end_address, and its name
 //                    could be a short bfd_name.
+// Symbols are created by SymbolArena::New, and live as long as their arena.
 class Symbol {
  public:
   // This constructor is used to create inlined symbol.
-#if defined(HAVE_LLVM)
-  Symbol(const char *name, llvm::StringRef dir, llvm::StringRef file,
-         uint32_t start)
-#else
-  Symbol(const char *name, std::string dir, std::string file, uint32_t start)
-#endif
+  Symbol(SymbolArena *arena, const char *name, absl::string_view dir,
+         absl::string_view file, uint32_t start)
       : info(SourceInfo(name, dir, file, start, 0, 0)),
         total_count(0),
         total_count_incl(0),
         head_count(0),
-        callsites(0),
-        pos_counts() {
+        callsites(0, CallsiteMap::allocator_type(arena->resource())),
+        arena(arena) {
   }
 
   // This constructor is used to create aliased symbol.
-  Symbol(const Symbol *src, const char *new_func_name)
+  Symbol(SymbolArena *arena, const Symbol *src, const char *new_func_name)
       : info(src->info),
         total_count(src->total_count),
         total_count_incl(src->total_count_incl),
         head_count(src->head_count),
-        callsites(0),
-        pos_counts() {
+        callsites(0, CallsiteMap::allocator_type(arena->resource())),
+        arena(arena) {
     info.func_name = new_func_name;
   }
 
-  Symbol()
+  explicit Symbol(SymbolArena *arena)
       : total_count(0),
         total_count_incl(0),
         head_count(0),
-        callsites(0),
-        pos_counts() {}
-
-  ~Symbol();
+        callsites(0, CallsiteMap::allocator_type(arena->resource())),
+        arena(arena) {}
 
   static std::string Name(const char *name) {
     return (name && strlen(name) > 0) ? name : "noname";
@@ -167,7 +232,8 @@ class Symbol {
                                               SymbolMap &, uint64_t &,
                                               uint64_t &);
 
-  // Merges profile stored in src symbol with this symbol.
+  // Merges profile stored in src symbol with this symbol. The callees that
+  // this symbol does not have yet are copied into its arena.
   void Merge(const Symbol *src);
 
   // Get an estimation of head count from the starting source or callsite
@@ -190,11 +256,10 @@ class Symbol {
   // Returns true if the symbol is from a header file.
   bool IsFromHeader() const;
 
-  void ComputeTotalCountIncl(const NameSymbolMap &nsmap,
-                             std::vector<Symbol *> *stacksyms,
-                             absl::flat_hash_set<Symbol *> *scc);
-  void BuildCallGraph(const NameSymbolMap &nsmap, SCCNode *callerSCC,
-                      CallGraph *callgraph);
+  // Computes total_count_incl of the symbol and its inline instances, from
+  // the total_count_incl of the symbols it calls outside of the component
+  // SCC of CALLGRAPH.
+  void ComputeTotalCountIncl(const CallGraph &callgraph, int scc);
 
   // Dumps the body of the symbol.
   void DumpBody(int ident, bool for_analysis) const;
@@ -221,10 +286,19 @@ class Symbol {
   CallsiteMap callsites;
   // Map from source location to count and instruction number.
   PositionCountMap pos_counts;
+  // The arena that this symbol and its callees are allocated from.
+  SymbolArena *arena;
 };
 
-// Vector of unique pointers to symbols.
-typedef std::vector<std::unique_ptr<Symbol>> SymbolUniquePtrVector;
+template <typename... Args>
+Symbol *SymbolArena::New(Args &&... args) {
+  std::unique_lock<std::mutex> lock = Lock();
+  void *memory = blocks_.allocate(sizeof(Symbol), alignof(Symbol));
+  Symbol *symbol = new (memory) Symbol(this, std::forward<Args>(args)...);
+  symbols_.push_back(symbol);
+  return symbol;
+}
+
 // Maps symbol's start address to its name and size.
 typedef std::map<uint64_t, std::pair<std::string, uint64_t>> AddressSymbolMap;
 // Maps from symbol's name to its start address.
@@ -251,6 +325,7 @@ class SymbolMap {
     if (!binary.empty()) {
       BuildSymbolMap();
       BuildNameAddressMap();
+      function_address_table_ = FunctionAddressTable(address_symbol_map_);
     }
   }
 
@@ -289,6 +364,12 @@ class SymbolMap {
   // Returns relocation start address.
   uint64_t base_addr() const { return base_addr_; }
 
+  // Makes the relocation start address that of the binary's symbol NAME,
+  // for samples that are relative to it, such as those of a Linux kernel
+  // (see SampleReader::kernel_reference_symbol). Returns false if the
+  // binary has no such symbol.
+  bool SetBaseAddrToSymbol(const std::string &name);
+
   void set_ignore_thresholds(bool v) {
     ignore_thresholds_ = v;
   }
@@ -310,9 +391,10 @@ class SymbolMap {
   // symbols with zero counts will be removed when profile is written out.
   void RemoveSymsMatchingRegex(const std::string &regex_str);
 
-  // Adds the given symbols and their mappings to the symbol map. SymbolMap
-  // takes ownership of the symbols in new_map. Existing mappings in SymbolMap
-  // that overlap with entries in new_map, will be updated to the new symbols.
+  // Adds copies of the given symbols and their mappings to the symbol map.
+  // The symbols in new_map stay owned by their own arena. Existing mappings
+  // in SymbolMap that overlap with entries in new_map, will be updated to the
+  // new symbols.
   void AddSymbolMappings(const NameSymbolMap &new_map);
 
   const NameSymbolMap &map() const {
@@ -321,6 +403,12 @@ class SymbolMap {
 
   const NameAddressMap &GetNameAddrMap() const { return name_addr_map_; }
 
+  // Writes the part of the symbol map that is read from the binary to the
+  // skeleton file PATH, which later SymbolMaps of the same binary load when
+  // it is in --symbol_skeleton_dir. Must be called before anything else is
+  // added to the symbol map.
+  bool WriteSkeleton(const std::string &path) const;
+
   const gcov_working_set_info *GetWorkingSets() const {
     return working_set_;
   }
@@ -384,7 +472,8 @@ class SymbolMap {
   //   data_source: the type of data used to generate autofdo profile.
   //   Typically it is perf data, autofdo proto or some other autofdo
   //   profile.
-  void AddSourceCount(const std::string &symbol, const SourceStack &source,
+  void AddSourceCount(const std::string &symbol,
+                      absl::Span<const SourceInfo> source,
                       uint64_t count, uint64_t num_inst,
                       uint32_t duplication = 1,
                       DataSource data_source = AFDOPROFILE);
@@ -425,8 +514,9 @@ class SymbolMap {
   //   Typically it is perf data, autofdo proto or some other autofdo
   //   profile.
   // Returns false if we failed to add the call target.
-  bool AddIndirectCallTarget(const std::string &symbol, const SourceStack &src,
-                             const std::string &target, uint64_t count,
+  bool AddIndirectCallTarget(const std::string &symbol,
+                             absl::Span<const SourceInfo> src,
+                             absl::string_view target, uint64_t count,
                              DataSource data_source = AFDOPROFILE);
 
   // Traverses the inline stack in source, update the symbol map by adding
@@ -436,9 +526,21 @@ class SymbolMap {
   //   Typically it is perf data, autofdo proto or some other autofdo
   //   profile.
   Symbol *TraverseInlineStack(const std::string &symbol,
-                              const SourceStack &source, uint64_t count,
+                              absl::Span<const SourceInfo> source,
+                              uint64_t count,
                               DataSource data_source = AFDOPROFILE);
 
+  // Makes AddSymbolEntryCount, AddSourceCount and AddIndirectCallTarget safe
+  // to call from several threads at once, e.g. to accumulate the profiles of
+  // different functions in parallel. The inline tree of each outline symbol
+  // is updated under one of a fixed set of locks, picked by hashing the
+  // symbol, and the arena is locked for each allocation. The symbols have to
+  // be added beforehand, and no other method may run concurrently with them.
+  // Counts are added up, or maxed, so the result does not depend on how the
+  // threads interleave, except that AddIndirectCallTarget overwrites the
+  // count of a target: a given call site should be fed from one thread.
+  void set_concurrent_accumulation(bool concurrent);
+
   // Updates function name, start_addr, end_addr of a function that has a
   // given address. Returns false if no such symbol exists.
   const bool GetSymbolInfoByAddr(uint64_t addr, const std::string **name,
@@ -449,6 +551,12 @@ class SymbolMap {
   // NULL if no such symbol exists.
   const std::string *GetSymbolNameByStartAddr(uint64_t address) const;
 
+  // Returns the flat function address table. Use its SortedLookup to resolve
+  // address-ordered sample streams.
+  const FunctionAddressTable &function_address_table() const {
+    return function_address_table_;
+  }
+
   // Returns the overlap between two symbol maps. For two profiles, if
   // count_i_j denotes the function count of the ith function in profile j;
   // total_j denotes the total count of all functions in profile j. Then
@@ -491,7 +599,6 @@ class SymbolMap {
   std::map<uint64_t, uint64_t> GetLegacySymbolStartAddressSizeMap() const;
 
   void ComputeTotalCountIncl();
-  void BuildCallGraph(CallGraph *callgraph);
 
   void Dump(bool dump_for_analysis = false) const;
   void DumpFuncLevelProfileCompare(const SymbolMap &map) const;
@@ -517,9 +624,16 @@ class SymbolMap {
 #endif
 
  private:
-  // Reads from the binary's elf section to build the symbol map.
+  // Reads from the binary's elf section, or from its skeleton, to build the
+  // symbol map.
   void BuildSymbolMap();
 
+  // Adds a function symbol of the binary to address_symbol_map_. Symbols
+  // must be added in address order; a symbol at the same address as the
+  // last one added is recorded as its alias.
+  void AddBinarySymbol(uint64_t address, uint64_t size,
+                       absl::string_view name);
+
   // Initialize suffix elision policy from flags.
   void initSuffixElisionPolicy();
 
@@ -530,11 +644,34 @@ class SymbolMap {
     }
   }
 
-  SymbolUniquePtrVector unique_symbols_;  // Owns the symbols.
+  // Returns the leaf symbol of SOURCE in the inline tree of the outline
+  // SYMBOL, as TraverseInlineStack above.
+  Symbol *TraverseInlineStack(Symbol *symbol,
+                              absl::Span<const SourceInfo> source,
+                              uint64_t count, DataSource data_source);
+
+  // Locks the inline tree of the outline SYMBOL when accumulation is
+  // concurrent. Returns an empty lock otherwise.
+  std::unique_lock<std::mutex> LockOutlineSymbol(const Symbol *symbol);
+
+  // Creates an outline symbol in arena_, passing ARGS to its constructor.
+  template <typename... Args>
+  Symbol *NewOutlineSymbol(Args &&... args) {
+    unique_symbols_.push_back(arena_.New(std::forward<Args>(args)...));
+    return unique_symbols_.back();
+  }
+
+  SymbolArena arena_;  // Owns the symbols.
+  std::vector<Symbol *> unique_symbols_;  // The outline symbols.
+  // The locks of the outline symbols when accumulation is concurrent, null
+  // otherwise.
+  std::unique_ptr<std::mutex[]> symbol_locks_;
   NameSymbolMap map_;
   NameAliasMap name_alias_map_;
   NameAddressMap name_addr_map_;
   AddressSymbolMap address_symbol_map_;
+  // Flat copy of address_symbol_map_ used for address lookups.
+  FunctionAddressTable function_address_table_;
   const std::string binary_;
   uint64_t base_addr_;
   int64_t count_threshold_;
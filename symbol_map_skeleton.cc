@@ -0,0 +1,125 @@
+// Class to save and load the binary-only part of a SymbolMap.
+
+#include "symbol_map_skeleton.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "base/logging.h"
+
+namespace {
+const char kMagic[8] = {'A', 'F', 'D', 'O', 'S', 'K', 'E', 'L'};
+}  // namespace
+
+namespace devtools_crosstool_autofdo {
+
+constexpr uint32_t SymbolMapSkeleton::kVersion;
+
+SymbolMapSkeleton::~SymbolMapSkeleton() {
+  if (data_ != nullptr) munmap(const_cast<char *>(data_), data_size_);
+}
+
+std::string SymbolMapSkeleton::FileName(const std::string &build_id) {
+  return build_id + ".skel";
+}
+
+bool SymbolMapSkeleton::Write(const std::string &path,
+                              const std::string &build_id, uint64_t base_addr,
+                              const std::vector<SymbolToWrite> &symbols) {
+  std::vector<Symbol> records;
+  records.reserve(symbols.size());
+  std::string strings;
+  for (const SymbolToWrite &symbol : symbols) {
+    records.push_back(
+        {symbol.address, symbol.size, strings.size(), symbol.name.size()});
+    strings.append(symbol.name.data(), symbol.name.size());
+  }
+
+  Header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.build_id_size = build_id.size();
+  header.build_id_offset = strings.size();
+  header.base_addr = base_addr;
+  header.num_symbols = records.size();
+  strings.append(build_id);
+  header.strings_size = strings.size();
+
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (fp == nullptr) {
+    LOG(ERROR) << "Cannot open " << path << " to write";
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(records.data(), sizeof(Symbol), records.size(), fp) ==
+                records.size() &&
+            fwrite(strings.data(), 1, strings.size(), fp) == strings.size();
+  if (fclose(fp) != 0) ok = false;
+  if (!ok) LOG(ERROR) << "Error writing " << path;
+  return ok;
+}
+
+bool SymbolMapSkeleton::Load(const std::string &path,
+                             const std::string &build_id) {
+  CHECK(data_ == nullptr);
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    close(fd);
+    LOG(WARNING) << path << " is not a symbol map skeleton";
+    return false;
+  }
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    PLOG(WARNING) << "Could not mmap " << path;
+    return false;
+  }
+  data_ = static_cast<const char *>(data);
+  data_size_ = st.st_size;
+
+  const Header *h = header();
+  const char *error = nullptr;
+  if (memcmp(h->magic, kMagic, sizeof(kMagic)) != 0) {
+    error = "is not a symbol map skeleton";
+  } else if (h->version != kVersion) {
+    error = "has an unsupported version";
+  } else if (h->num_symbols > (data_size_ - sizeof(Header)) / sizeof(Symbol) ||
+             h->strings_size != data_size_ - sizeof(Header) -
+                                    h->num_symbols * sizeof(Symbol)) {
+    error = "is truncated";
+  } else if (h->build_id_offset > h->strings_size ||
+             h->build_id_size > h->strings_size - h->build_id_offset ||
+             build_id != absl::string_view(strings() + h->build_id_offset,
+                                           h->build_id_size)) {
+    error = "is for another build-id";
+  } else {
+    for (size_t i = 0; i < h->num_symbols; ++i) {
+      const Symbol &symbol = symbols()[i];
+      if (symbol.name_offset > h->strings_size ||
+          symbol.name_size > h->strings_size - symbol.name_offset ||
+          (i > 0 && symbol.address < symbols()[i - 1].address)) {
+        error = "is corrupted";
+        break;
+      }
+    }
+  }
+  if (error != nullptr) {
+    LOG(WARNING) << path << " " << error << ", ignoring it";
+    munmap(data, data_size_);
+    data_ = nullptr;
+    data_size_ = 0;
+    return false;
+  }
+  return true;
+}
+}  // namespace devtools_crosstool_autofdo
@@ -0,0 +1,100 @@
+// Class to save and load the binary-only part of a SymbolMap.
+
+#ifndef AUTOFDO_SYMBOL_MAP_SKELETON_H_
+#define AUTOFDO_SYMBOL_MAP_SKELETON_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "third_party/abseil/absl/strings/string_view.h"
+
+namespace devtools_crosstool_autofdo {
+
+// A symbol map skeleton holds what SymbolMap derives from the binary alone:
+// the base address and the function symbols kept from its symbol tables.
+// It is written once per binary by create_symbol_skeleton, to a file named
+// after the binary's build-id, and mapped in place of reading the ELF
+// symbol tables by every later conversion of a profile of that binary.
+//
+// File layout, in the byte order of the machine that wrote it:
+//   Header
+//   Symbol[num_symbols], sorted by address
+//   char strings[strings_size], holding the symbol names and the build-id
+// A symbol at the same address as the one before it is an alias of the
+// first symbol at that address.
+class SymbolMapSkeleton {
+ public:
+  // Bumped whenever the layout or the meaning of the file changes.
+  static constexpr uint32_t kVersion = 1;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t build_id_size;
+    uint64_t build_id_offset;
+    uint64_t base_addr;
+    uint64_t num_symbols;
+    uint64_t strings_size;
+  };
+
+  struct Symbol {
+    uint64_t address;
+    uint64_t size;
+    uint64_t name_offset;
+    uint64_t name_size;
+  };
+
+  // A symbol to write, whose name is not yet in the string table.
+  struct SymbolToWrite {
+    uint64_t address;
+    uint64_t size;
+    absl::string_view name;
+  };
+
+  SymbolMapSkeleton() : data_(nullptr), data_size_(0) {}
+  ~SymbolMapSkeleton();
+
+  // Returns the file name of the skeleton of the binary with BUILD_ID.
+  static std::string FileName(const std::string &build_id);
+
+  // Writes the skeleton of the binary with BUILD_ID to PATH. SYMBOLS must
+  // be sorted by address. Returns false if PATH cannot be written.
+  static bool Write(const std::string &path, const std::string &build_id,
+                    uint64_t base_addr,
+                    const std::vector<SymbolToWrite> &symbols);
+
+  // Maps the skeleton file PATH. Returns false if it cannot be read, has
+  // another version or is not the skeleton of the binary with BUILD_ID.
+  bool Load(const std::string &path, const std::string &build_id);
+
+  uint64_t base_addr() const { return header()->base_addr; }
+  size_t num_symbols() const { return header()->num_symbols; }
+  uint64_t address(size_t i) const { return symbols()[i].address; }
+  uint64_t size(size_t i) const { return symbols()[i].size; }
+  absl::string_view name(size_t i) const {
+    return absl::string_view(strings() + symbols()[i].name_offset,
+                             symbols()[i].name_size);
+  }
+
+ private:
+  const Header *header() const {
+    return reinterpret_cast<const Header *>(data_);
+  }
+  const Symbol *symbols() const {
+    return reinterpret_cast<const Symbol *>(data_ + sizeof(Header));
+  }
+  const char *strings() const {
+    return data_ + sizeof(Header) + header()->num_symbols * sizeof(Symbol);
+  }
+
+  // The mapped file.
+  const char *data_;
+  size_t data_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(SymbolMapSkeleton);
+};
+}  // namespace devtools_crosstool_autofdo
+
+#endif  // AUTOFDO_SYMBOL_MAP_SKELETON_H_
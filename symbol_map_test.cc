@@ -5,25 +5,48 @@
 // from the binary.
 #include "symbol_map.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "base/logging.h"
 #include "llvm_profile_reader.h"
 #include "source_info.h"
+#include "symbol_map_skeleton.h"
+#include "util/symbolize/elf_reader.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
-#include "third_party/abseil/absl/container/node_hash_set.h"
+#include "third_party/abseil/absl/cleanup/cleanup.h"
 #include "third_party/abseil/absl/flags/flag.h"
+#include "third_party/abseil/absl/hash/hash.h"
+#include "third_party/abseil/absl/strings/str_cat.h"
+#include "third_party/abseil/absl/strings/str_replace.h"
 #include "third_party/abseil/absl/types/optional.h"
 
+ABSL_DECLARE_FLAG(std::string, symbol_skeleton_dir);
+ABSL_DECLARE_FLAG(int32_t, total_count_incl_threads);
+
 #define FLAGS_test_tmpdir std::string(testing::UnitTest::GetInstance()->original_working_dir())
 
 #define FLAGS_test_srcdir std::string(testing::UnitTest::GetInstance()->original_working_dir())
 
 namespace {
 
+using ::devtools_crosstool_autofdo::CallTargetCountMap;
+using ::devtools_crosstool_autofdo::ElfReader;
+using ::devtools_crosstool_autofdo::FlatMap;
+using ::devtools_crosstool_autofdo::FunctionAddressTable;
+using ::devtools_crosstool_autofdo::FunctionNameTable;
 using ::devtools_crosstool_autofdo::SymbolMap;
+using ::devtools_crosstool_autofdo::SymbolMapSkeleton;
 using ::devtools_crosstool_autofdo::SourceStack;
+using ::devtools_crosstool_autofdo::TargetCountPairs;
 
 class SymbolMapTest : public testing::Test {
  protected:
@@ -33,6 +56,32 @@ class SymbolMapTest : public testing::Test {
 const char kTestDataDir[] =
     "/testdata/";
 
+// Returns a dump of the counts in the inline tree of SYMBOL, with the
+// callsites in a fixed order.
+std::string DumpInlineTree(const devtools_crosstool_autofdo::Symbol *symbol) {
+  std::string dump =
+      absl::StrCat(symbol->info.func_name ? symbol->info.func_name : "", " ",
+                   symbol->head_count, " ", symbol->total_count, " {");
+  for (const auto &[offset, info] : symbol->pos_counts) {
+    absl::StrAppend(&dump, " ", offset, ":", info.count, "/", info.num_inst);
+    TargetCountPairs target_counts;
+    GetTargetCountPairsByName(info.target_map, &target_counts);
+    for (const auto &[target, count] : target_counts) {
+      absl::StrAppend(&dump, " ", target, "=", count);
+    }
+  }
+  std::vector<std::string> callsites;
+  for (const auto &[callsite, callee] : symbol->callsites) {
+    callsites.push_back(
+        absl::StrCat(callsite.first, ": ", DumpInlineTree(callee)));
+  }
+  std::sort(callsites.begin(), callsites.end());
+  for (const std::string &callsite : callsites) {
+    absl::StrAppend(&dump, " ", callsite);
+  }
+  return absl::StrCat(dump, " }");
+}
+
 TEST(SymbolMapTest, SymbolMap) {
   SymbolMap symbol_map(
       FLAGS_test_srcdir + kTestDataDir + "test.binary");
@@ -125,10 +174,98 @@ TEST(SymbolMapTest, TestEntryCount) {
   EXPECT_EQ(qux->EntryCount(), 100);
 }
 
+TEST(SymbolMapTest, AddSymbolMappingsCopiesSymbols) {
+  SymbolMap symbol_map;
+  {
+    SymbolMap other_map;
+    other_map.AddSymbol("foo");
+    SourceStack stack = {
+        {"baz", "", "", 0, 20, 0},
+        {"bar", "", "", 0, 25, 0},
+        {"foo", "", "", 0, 50, 0},
+    };
+    other_map.AddSourceCount("foo", stack, 100, 2);
+    devtools_crosstool_autofdo::NameSymbolMap new_map = other_map.map();
+    new_map["foo_alias"] = new_map["foo"];
+    symbol_map.AddSymbolMappings(new_map);
+    EXPECT_NE(symbol_map.map().at("foo"), other_map.map().at("foo"));
+  }
+
+  // The copies do not refer to the symbols of the destroyed map.
+  const devtools_crosstool_autofdo::Symbol *symbol =
+      symbol_map.map().at("foo");
+  EXPECT_EQ(symbol_map.map().at("foo_alias"), symbol);
+  EXPECT_EQ(symbol->total_count, 100);
+  ASSERT_EQ(symbol->callsites.size(), 1);
+  const devtools_crosstool_autofdo::Symbol *bar =
+      symbol->callsites.begin()->second;
+  EXPECT_STREQ(bar->info.func_name, "bar");
+  EXPECT_EQ(bar->total_count, 100);
+  ASSERT_EQ(bar->callsites.size(), 1);
+  const devtools_crosstool_autofdo::Symbol *baz =
+      bar->callsites.begin()->second;
+  EXPECT_EQ(baz->total_count, 100);
+  ASSERT_EQ(baz->pos_counts.size(), 1);
+  EXPECT_EQ(baz->pos_counts.begin()->second.count, 100);
+  EXPECT_EQ(baz->pos_counts.begin()->second.num_inst, 2);
+}
+
+TEST(SymbolMapTest, ConcurrentAccumulation) {
+  const int kNumThreads = 4;
+  const int kNumFunctions = 8;
+  const int kNumSamples = 2000;
+  const char *const kFunctions[kNumFunctions] = {"f0", "f1", "f2", "f3",
+                                                 "f4", "f5", "f6", "f7"};
+  const char *const kInlinees[] = {"g", "h", "k"};
+  // Feeds the samples I such that I % NUM_THREADS == THREAD to SYMBOL_MAP.
+  // Every thread updates every function, and "callee".
+  auto accumulate = [&](SymbolMap *symbol_map, int thread, int num_threads) {
+    for (int i = thread; i < kNumSamples; i += num_threads) {
+      const char *function = kFunctions[i % kNumFunctions];
+      SourceStack stack = {
+          {kInlinees[i % 3], "", "", 0, static_cast<uint32_t>(i % 13), 0},
+          {kInlinees[i % 2], "", "", 0, static_cast<uint32_t>(i % 5), 0},
+          {function, "", "", 0, static_cast<uint32_t>(i % 7), 0},
+      };
+      stack.resize(1 + i % 3);
+      stack.back().func_name = function;
+      symbol_map->AddSourceCount(function, stack, i, 1);
+      symbol_map->AddSymbolEntryCount("callee", 1, i);
+      // Each call site is fed by one thread.
+      SourceStack call_stack = {
+          {function, "", "", 0, static_cast<uint32_t>(1000 + i), 0}};
+      symbol_map->AddIndirectCallTarget(function, call_stack, "callee", i);
+    }
+  };
+
+  SymbolMap serial_map;
+  SymbolMap concurrent_map;
+  for (SymbolMap *symbol_map : {&serial_map, &concurrent_map}) {
+    for (const char *function : kFunctions) symbol_map->AddSymbol(function);
+    symbol_map->AddSymbol("callee");
+  }
+  accumulate(&serial_map, 0, 1);
+
+  concurrent_map.set_concurrent_accumulation(true);
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < kNumThreads; ++thread) {
+    threads.emplace_back(accumulate, &concurrent_map, thread, kNumThreads);
+  }
+  for (std::thread &thread : threads) thread.join();
+  concurrent_map.set_concurrent_accumulation(false);
+
+  ASSERT_EQ(concurrent_map.size(), serial_map.size());
+  for (const auto &[name, symbol] : serial_map.map()) {
+    EXPECT_EQ(DumpInlineTree(concurrent_map.map().at(name)),
+              DumpInlineTree(symbol))
+        << name;
+  }
+  EXPECT_EQ(concurrent_map.map().at("callee")->head_count, kNumSamples);
+}
+
 TEST(SymbolMapTest, ComputeAllCounts) {
   SymbolMap symbol_map;
-  absl::node_hash_set<std::string> names;
-  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map, names);
+  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map);
   reader.ReadFromFile(FLAGS_test_srcdir + kTestDataDir +
                       "callgraph_with_cycles.txt");
 
@@ -142,6 +279,88 @@ TEST(SymbolMapTest, ComputeAllCounts) {
   EXPECT_EQ(map.find("moo")->second->total_count_incl, 50);
 }
 
+// Reads PROFILE, computes total_count_incl with NUM_THREADS threads and
+// returns the counts of all the symbols.
+std::map<std::string, uint64_t> ComputeTotalCountIncl(
+    const std::string &profile, int num_threads) {
+  absl::SetFlag(&FLAGS_total_count_incl_threads, num_threads);
+  SymbolMap symbol_map;
+  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map);
+  EXPECT_TRUE(reader.ReadFromFile(profile));
+  symbol_map.ComputeTotalCountIncl();
+  absl::SetFlag(&FLAGS_total_count_incl_threads, 0);
+  std::map<std::string, uint64_t> counts;
+  for (const auto &[name, symbol] : symbol_map.map()) {
+    counts[name] = symbol->total_count_incl;
+  }
+  return counts;
+}
+
+TEST(SymbolMapTest, ComputeAllCountsInParallel) {
+  // 64 renamed copies of the call graph, so that each wave has enough
+  // components for 4 threads.
+  std::ifstream in(FLAGS_test_srcdir + kTestDataDir +
+                   "callgraph_with_cycles.txt");
+  std::stringstream callgraph;
+  callgraph << in.rdbuf();
+  std::string copies;
+  const int kNumCopies = 64;
+  for (int i = 0; i < kNumCopies; ++i) {
+    const std::string prefix = absl::StrCat("copy", i, "_");
+    absl::StrAppend(
+        &copies,
+        absl::StrReplaceAll(callgraph.str(), {{"main:", prefix + "main:"},
+                                              {"foo:", prefix + "foo:"},
+                                              {"goo:", prefix + "goo:"},
+                                              {"hoo:", prefix + "hoo:"},
+                                              {"moo:", prefix + "moo:"}}),
+        "\n");
+  }
+  const std::string profile = FLAGS_test_tmpdir + "/callgraph_copies.txt";
+  std::ofstream(profile) << copies;
+
+  const std::map<std::string, uint64_t> serial =
+      ComputeTotalCountIncl(profile, 1);
+  const std::map<std::string, uint64_t> parallel =
+      ComputeTotalCountIncl(profile, 4);
+  remove(profile.c_str());
+  ASSERT_EQ(serial.size(), 4 * kNumCopies);
+  EXPECT_EQ(parallel, serial);
+  for (int i = 0; i < kNumCopies; ++i) {
+    const std::string prefix = absl::StrCat("copy", i, "_");
+    EXPECT_EQ(parallel.at(prefix + "main"), 21414) << prefix;
+    EXPECT_EQ(parallel.at(prefix + "goo"), 15050) << prefix;
+    EXPECT_EQ(parallel.at(prefix + "hoo"), 15050) << prefix;
+    EXPECT_EQ(parallel.at(prefix + "moo"), 50) << prefix;
+  }
+}
+
+TEST(SymbolMapTest, ComputeTotalCountInclOfDeepInlineStack) {
+  SymbolMap symbol_map;
+  symbol_map.AddSymbol("foo");
+  symbol_map.AddSymbol("bar");
+  symbol_map.AddSymbolEntryCount("bar", 5, 10);
+
+  // foo inlines a chain of 200000 functions, the last of which calls bar.
+  const int kDepth = 200000;
+  std::vector<std::string> names(kDepth);
+  SourceStack stack;
+  for (int i = 0; i < kDepth; ++i) {
+    names[i] = absl::StrCat("f", i);
+    stack.emplace_back(names[i].c_str(), "", "", 0, 1, 0);
+  }
+  stack.emplace_back("foo", "", "", 0, 1, 0);
+  symbol_map.AddSourceCount("foo", stack, 1, 1);
+  symbol_map.AddIndirectCallTarget("foo", stack, "bar", 2);
+
+  symbol_map.ComputeTotalCountIncl();
+  // Each of the 2 calls to bar takes 10 / 5 samples.
+  const devtools_crosstool_autofdo::Symbol *foo = symbol_map.map().at("foo");
+  EXPECT_EQ(foo->total_count, 1);
+  EXPECT_EQ(foo->total_count_incl, 5);
+  EXPECT_EQ(symbol_map.map().at("bar")->total_count_incl, 10);
+}
+
 std::string GenRandomName(const int len) {
   std::string result(len, '\0');
   static const char alpha[] = "abcdefghijklmnopqrstuvwxyz";
@@ -173,14 +392,57 @@ TEST(SymbolMapTest, TestElideSuffixesAndMerge) {
   }
 }
 
+TEST(SymbolMapTest, ElideSuffixesAndMergeByPolicy) {
+  const std::vector<std::pair<std::string, uint64_t>> symbols = {
+      {"foo", 1},        {"foo.cold", 2},   {"foo.llvm.123", 4},
+      {"foo.llvm.123.cold", 8}, {"foo.part.1", 16}, {"bar.cold", 32}};
+  const std::vector<std::pair<std::string, std::map<std::string, uint64_t>>>
+      policies = {
+          {"all", {{"foo", 31}, {"bar", 32}, {"baz", 64}, {"qux", 64}}},
+          {"selected",
+           {{"foo", 15}, {"foo.part.1", 16}, {"bar", 32}, {"baz", 64},
+            {"qux", 64}}},
+          {"none",
+           {{"foo", 1}, {"foo.cold", 2}, {"foo.llvm.123", 4},
+            {"foo.llvm.123.cold", 8}, {"foo.part.1", 16}, {"bar.cold", 32},
+            {"baz.cold", 64}, {"qux", 64}}}};
+  for (const auto &[policy, expected] : policies) {
+    SCOPED_TRACE(policy);
+    SymbolMap symbol_map;
+    symbol_map.set_suffix_elision_policy(policy);
+    for (const auto &[name, count] : symbols) {
+      symbol_map.AddSymbol(name);
+      symbol_map.AddSymbolEntryCount(name, count, count);
+    }
+    // "qux" is an alias of "baz.cold", and follows it when it is merged.
+    SymbolMap other_map;
+    other_map.AddSymbol("baz.cold");
+    other_map.AddSymbolEntryCount("baz.cold", 64, 64);
+    devtools_crosstool_autofdo::NameSymbolMap aliases = other_map.map();
+    aliases["qux"] = aliases["baz.cold"];
+    symbol_map.AddSymbolMappings(aliases);
+
+    symbol_map.ElideSuffixesAndMerge();
+
+    std::map<std::string, uint64_t> counts;
+    for (const auto &[name, symbol] : symbol_map.map()) {
+      counts[name] = symbol->total_count;
+      EXPECT_EQ(symbol->head_count, symbol->total_count) << name;
+    }
+    EXPECT_EQ(counts, expected);
+    if (policy != "none") {
+      EXPECT_EQ(symbol_map.map().at("qux"), symbol_map.map().at("baz"));
+    }
+  }
+}
+
 TEST(SymbolMapTest, TestInterestingSymbolNames) {
   const char *policies[] = { "all", "none", "selected" };
   for (auto p : policies) {
     std::string policy(p);
     SymbolMap symbol_map;
     symbol_map.set_suffix_elision_policy(policy);
-    absl::node_hash_set<std::string> names;
-    devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map, names);
+    devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map);
         reader.ReadFromFile(FLAGS_test_srcdir + kTestDataDir +
                             "symbols_with_fun_characters.txt");
 
@@ -197,7 +459,8 @@ TEST(SymbolMapTest, TestInterestingSymbolNames) {
 
         auto get_count =
             [&](std::string target_name) -> absl::optional<uint64> {
-          auto iter = target_counts.find(target_name);
+          auto iter =
+              target_counts.find(FunctionNameTable::Id(target_name));
           if (iter == target_counts.end()) return absl::nullopt;
           return iter->second;
         };
@@ -307,7 +570,7 @@ TEST(SymbolMapTest, BuildSelectivelyFlatProfile) {
   // location
   EXPECT_FALSE(got.map().find("cold_callsite1") != got.map().end());
   EXPECT_TRUE(got.map().at("cold_fn")->pos_counts[50l << 32].target_map.find(
-                  "cold_callsite1") !=
+                  FunctionNameTable::Id("cold_callsite1")) !=
               got.map().at("cold_fn")->pos_counts[50l << 32].target_map.end());
   EXPECT_EQ(total, 2);
   EXPECT_EQ(numFlattened, 1);
@@ -347,7 +610,7 @@ TEST(SymbolMapTest, BuildHybridProfile) {
   EXPECT_TRUE(got.map().find("cold_callsite1") != got.map().end());
   ASSERT_TRUE(got.map().find("cold_fn") != got.map().end());
   EXPECT_TRUE(got.map().at("cold_fn")->pos_counts[50l << 32].target_map.find(
-                  "cold_callsite1") !=
+                  FunctionNameTable::Id("cold_callsite1")) !=
               got.map().at("cold_fn")->pos_counts[50l << 32].target_map.end());
   EXPECT_TRUE(got.map().find("cold_callsite2") != got.map().end());
   EXPECT_TRUE(got.map().find("cold_callsite3") != got.map().end());
@@ -371,8 +634,7 @@ TEST(SymbolMapTest, FSDiscriminator) {
 
 TEST(SymbolMapTest, RemoveSymsMatchingRegex) {
   SymbolMap symbol_map;
-  absl::node_hash_set<std::string> names;
-  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map, names);
+  devtools_crosstool_autofdo::LLVMProfileReader reader(&symbol_map);
   reader.ReadFromFile(FLAGS_test_srcdir + kTestDataDir +
                       "strip_symbols_regex.textprof");
 
@@ -400,4 +662,201 @@ TEST(SymbolMapTest, RemoveSymsMatchingRegex) {
             0);
 }
 
+TEST(SymbolMapTest, FunctionAddressTable) {
+  std::map<uint64_t, std::pair<std::string, uint64_t>> symbols = {
+      {0x1000, {"foo", 0x10}},
+      {0x1010, {"bar", 0x20}},
+      {0x1100, {"baz", 0x8}}};
+  FunctionAddressTable table(symbols);
+  ASSERT_EQ(table.size(), 3);
+
+  EXPECT_EQ(table.Find(0xfff), FunctionAddressTable::kNotFound);
+  EXPECT_EQ(table.name(table.Find(0x1000)), "foo");
+  EXPECT_EQ(table.name(table.Find(0x100f)), "foo");
+  EXPECT_EQ(table.name(table.Find(0x1010)), "bar");
+  EXPECT_EQ(table.Find(0x1030), FunctionAddressTable::kNotFound);
+  EXPECT_EQ(table.name(table.Find(0x1107)), "baz");
+  EXPECT_EQ(table.Find(0x1108), FunctionAddressTable::kNotFound);
+  EXPECT_EQ(table.FindStart(0x1010), 1);
+  EXPECT_EQ(table.FindStart(0x1011), FunctionAddressTable::kNotFound);
+
+  // The sorted lookup must agree with the binary search.
+  FunctionAddressTable::SortedLookup lookup(table);
+  for (uint64_t addr = 0xff0; addr < 0x1120; addr += 3) {
+    EXPECT_EQ(lookup.Find(addr), table.Find(addr)) << std::hex << addr;
+  }
+}
+
+TEST(SymbolMapTest, FlatMap) {
+  typedef std::vector<std::pair<uint64_t, uint64_t>> Entries;
+  FlatMap<uint64_t, uint64_t> map;
+  for (uint64_t key : {5, 1, 9, 3, 9, 7}) map[key] += key;
+  Entries expected = {{1, 1}, {3, 3}, {5, 5}, {7, 7}, {9, 18}};
+  EXPECT_EQ(Entries(map.begin(), map.end()), expected);
+  EXPECT_EQ(map.find(4), map.end());
+  EXPECT_EQ(map.at(9), 18);
+
+  FlatMap<uint64_t, uint64_t> other;
+  for (uint64_t key : {0, 3, 8, 11}) other[key] = 100;
+  map.Merge(other, [](uint64_t *value, uint64_t other_value) {
+    *value += other_value;
+  });
+  expected = {{0, 100}, {1, 1}, {3, 103}, {5, 5}, {7, 7},
+              {8, 100}, {9, 18}, {11, 100}};
+  EXPECT_EQ(Entries(map.begin(), map.end()), expected);
+
+}
+
+TEST(SymbolMapTest, FunctionNameTable) {
+  EXPECT_EQ(FunctionNameTable::Id(""), 0);
+  EXPECT_EQ(FunctionNameTable::Name(0), "");
+
+  const uint32_t foo = FunctionNameTable::Id("_Z3fooi");
+  const uint32_t bar = FunctionNameTable::Id(std::string("_Z3bari"));
+  EXPECT_NE(foo, 0);
+  EXPECT_NE(foo, bar);
+  EXPECT_EQ(FunctionNameTable::Id(std::string("_Z3fooi")), foo);
+  EXPECT_EQ(FunctionNameTable::Name(foo), "_Z3fooi");
+  EXPECT_EQ(FunctionNameTable::Name(bar), "_Z3bari");
+  // Ids and interned copies refer to the same string.
+  EXPECT_EQ(FunctionNameTable::Name(foo).data(),
+            FunctionNameTable::Intern("_Z3fooi").data());
+  EXPECT_EQ(FunctionNameTable::Hash(foo),
+            absl::Hash<absl::string_view>()("_Z3fooi"));
+
+  uint32_t id = 0;
+  EXPECT_TRUE(FunctionNameTable::FindId("_Z3fooi", &id));
+  EXPECT_EQ(id, foo);
+  EXPECT_FALSE(FunctionNameTable::FindId("_Z3bazi_never_interned", &id));
+  EXPECT_EQ(id, foo);
+
+  // Call targets are kept as ids, and reported by name.
+  CallTargetCountMap target_map;
+  target_map[foo] += 1;
+  target_map[bar] += 2;
+  target_map[foo] += 3;
+  TargetCountPairs by_name;
+  GetTargetCountPairsByName(target_map, &by_name);
+  EXPECT_EQ(by_name, (TargetCountPairs{{"_Z3bari", 2}, {"_Z3fooi", 4}}));
+  TargetCountPairs by_count;
+  GetSortedTargetCountPairs(target_map, &by_count);
+  EXPECT_EQ(by_count, (TargetCountPairs{{"_Z3fooi", 4}, {"_Z3bari", 2}}));
+}
+
+TEST(SymbolMapTest, SortedElfSymbols) {
+  const std::string binary = FLAGS_test_srcdir + kTestDataDir + "test.binary";
+  ElfReader elf_reader(binary);
+  int num_symbols = 0;
+  elf_reader.ForEachSymbol(
+      [&num_symbols](const ElfReader::SymbolView &) { ++num_symbols; });
+  const auto &symbols = elf_reader.GetSortedSymbols();
+  ASSERT_EQ(symbols.size(), num_symbols);
+  ASSERT_GT(num_symbols, 0);
+  EXPECT_EQ(&elf_reader.GetSortedSymbols(), &symbols);
+  for (size_t i = 1; i < symbols.size(); ++i) {
+    EXPECT_LE(symbols[i - 1].address, symbols[i].address);
+  }
+
+  // Every function kept by the symbol map comes from the sorted symbols.
+  SymbolMap symbol_map(binary);
+  ASSERT_FALSE(symbol_map.GetNameAddrMap().empty());
+  for (const auto &name_addr : symbol_map.GetNameAddrMap()) {
+    EXPECT_TRUE(std::any_of(symbols.begin(), symbols.end(),
+                            [&name_addr](const ElfReader::SymbolView &symbol) {
+                              return symbol.name == name_addr.first &&
+                                     symbol.address == name_addr.second;
+                            }))
+        << name_addr.first;
+  }
+}
+
+// Returns "FUNCTION+OFFSET" for the sample at OFFSET in the mapping of the
+// binary of SYMBOL_MAP, or "" if no function has it.
+std::string ResolveSample(const SymbolMap &symbol_map, uint64_t offset) {
+  const std::string *name;
+  uint64_t start_addr;
+  const uint64_t addr = offset + symbol_map.base_addr();
+  if (!symbol_map.GetSymbolInfoByAddr(addr, &name, &start_addr, nullptr)) {
+    return "";
+  }
+  return absl::StrCat(*name, "+", addr - start_addr);
+}
+
+// testdata/test.ko is a kernel module: a C file built with -O1 -g
+// -falign-functions=32, relinked with ld -r so that .noinstr.text comes
+// before .text. The module loader lays out .noinstr.text (10 bytes) at
+// offset 0 of the mapping, then .text at offset 0x20, with module_add at 0
+// and module_mul at 0x20 in it. module_init_fn is in .init.text.
+TEST(SymbolMapTest, KernelModule) {
+  SymbolMap symbol_map(FLAGS_test_srcdir + kTestDataDir + "test.ko");
+  // Only the functions of .text are kept, since the addresses of the others
+  // are relative to their own section.
+  EXPECT_EQ(symbol_map.GetNameAddrMap(),
+            (devtools_crosstool_autofdo::NameAddressMap{{"module_add", 0},
+                                                        {"module_mul", 0x20}}));
+  EXPECT_EQ(symbol_map.base_addr(), 0 - uint64_t{0x20});
+
+  EXPECT_EQ(ResolveSample(symbol_map, 0x4), "");
+  EXPECT_EQ(ResolveSample(symbol_map, 0x20), "module_add+0");
+  EXPECT_EQ(ResolveSample(symbol_map, 0x24), "module_add+4");
+  EXPECT_EQ(ResolveSample(symbol_map, 0x43), "module_mul+3");
+  EXPECT_EQ(ResolveSample(symbol_map, 0x60), "");
+}
+
+// testdata/test.vmlinux is a kernel image linked at 0xffffffff81000000,
+// with startup_64 in .head.text there, and _stext at 0xffffffff81000100,
+// where do_timer (7 bytes) is followed by get_jiffies. Kernel samples are
+// relative to the runtime address of _stext, whatever the KASLR offset.
+TEST(SymbolMapTest, KernelSamplesRelativeToSymbol) {
+  SymbolMap symbol_map(FLAGS_test_srcdir + kTestDataDir + "test.vmlinux");
+  EXPECT_EQ(symbol_map.GetNameAddrMap().size(), 3);
+  EXPECT_EQ(symbol_map.base_addr(), 0xffffffff81000000);
+  EXPECT_FALSE(symbol_map.SetBaseAddrToSymbol("no_such_symbol"));
+  EXPECT_EQ(symbol_map.base_addr(), 0xffffffff81000000);
+
+  ASSERT_TRUE(symbol_map.SetBaseAddrToSymbol("_stext"));
+  EXPECT_EQ(symbol_map.base_addr(), 0xffffffff81000100);
+  EXPECT_EQ(ResolveSample(symbol_map, 0x2), "do_timer+2");
+  EXPECT_EQ(ResolveSample(symbol_map, 0x9), "get_jiffies+2");
+  EXPECT_EQ(ResolveSample(symbol_map, 0x20), "");
+}
+
+TEST(SymbolMapTest, Skeleton) {
+  const std::string binary =
+      FLAGS_test_srcdir + kTestDataDir + "test.fs.binary";
+  const std::string build_id = ElfReader(binary).GetBuildId();
+  ASSERT_FALSE(build_id.empty());
+  const std::string path =
+      FLAGS_test_tmpdir + "/" + SymbolMapSkeleton::FileName(build_id);
+  // Neither the flag nor the skeleton outlive the test, even when an
+  // assertion fails.
+  auto cleanup = absl::MakeCleanup([&path] {
+    absl::SetFlag(&FLAGS_symbol_skeleton_dir, "");
+    std::remove(path.c_str());
+  });
+
+  // A skeleton written from the symbol tables loads back to the same map.
+  SymbolMap from_elf(binary);
+  ASSERT_TRUE(from_elf.WriteSkeleton(path));
+  absl::SetFlag(&FLAGS_symbol_skeleton_dir, FLAGS_test_tmpdir);
+  SymbolMap from_skeleton(binary);
+  EXPECT_EQ(from_skeleton.GetNameAddrMap(), from_elf.GetNameAddrMap());
+
+  // The symbols come from the skeleton, not from the binary.
+  ASSERT_TRUE(SymbolMapSkeleton::Write(path, build_id, 0x400000,
+                                       {{0x401000, 0x10, "foo"},
+                                        {0x401000, 0x10, "foo_alias"},
+                                        {0x402000, 0x8, "bar"}}));
+  SymbolMap from_fake_skeleton(binary);
+  EXPECT_EQ(from_fake_skeleton.GetNameAddrMap(),
+            (std::map<std::string, uint64_t>{{"foo", 0x401000},
+                                             {"bar", 0x402000}}));
+
+  SymbolMapSkeleton skeleton;
+  EXPECT_FALSE(skeleton.Load(path, "0123456789abcdef"));
+  ASSERT_TRUE(skeleton.Load(path, build_id));
+  ASSERT_EQ(skeleton.num_symbols(), 3u);
+  EXPECT_EQ(skeleton.name(1), "foo_alias");
+}
+
 }  // namespace
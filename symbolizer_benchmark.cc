@@ -0,0 +1,270 @@
+// Benchmarks of the symbolizer the tools are built with, LLVMAddr2line or
+// Google3Addr2line, on the testdata binaries and on a larger binary that is
+// generated and compiled when the benchmark starts, e.g.
+//
+//   symbolizer_benchmark --testdata_dir=testdata --benchmark_filter=Prepare
+//
+// For each binary it measures:
+//   Prepare: the time to create a symbolizer and read the debug info, and
+//     the memory it holds on to.
+//   GetInlineStack: the latency of symbolizing one address, cycling through
+//     every byte of every function.
+//   InstructionMap: the time to build the instruction map of one function,
+//     cycling through the functions.
+// Every benchmark also reports the peak resident memory of the process.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "addr2line.h"
+#include "instruction_map.h"
+#include "source_info.h"
+#include "symbol_map.h"
+#include "benchmark/benchmark.h"
+#include "third_party/abseil/absl/flags/flag.h"
+#include "third_party/abseil/absl/flags/parse.h"
+#include "third_party/abseil/absl/strings/str_cat.h"
+
+ABSL_FLAG(std::string, testdata_dir, "testdata",
+          "Directory of the checked-in test binaries.");
+ABSL_FLAG(std::string, tmpdir, "/tmp",
+          "Directory to generate the synthetic binary in.");
+ABSL_FLAG(std::string, cxx, "c++",
+          "Compiler used to build the synthetic binary. If it fails, only "
+          "the testdata binaries are measured.");
+ABSL_FLAG(int32_t, synthetic_functions, 500,
+          "Number of functions in the synthetic binary.");
+ABSL_FLAG(int32_t, synthetic_inline_depth, 10,
+          "Depth of the inline stack of the code of each synthetic function.");
+
+namespace {
+
+using devtools_crosstool_autofdo::Addr2line;
+using devtools_crosstool_autofdo::InstructionMap;
+using devtools_crosstool_autofdo::SourceStack;
+using devtools_crosstool_autofdo::SymbolMap;
+
+#if defined(HAVE_LLVM)
+const char kSymbolizer[] = "LLVMAddr2line";
+#else
+const char kSymbolizer[] = "Google3Addr2line";
+#endif
+
+// Returns the resident memory of the process, in bytes.
+int64_t CurrentRss() {
+  long pages = 0, resident = 0;  // NOLINT(runtime/int)
+  FILE *fp = fopen("/proc/self/statm", "r");
+  if (fp == nullptr) return 0;
+  if (fscanf(fp, "%ld %ld", &pages, &resident) != 2) resident = 0;
+  fclose(fp);
+  return static_cast<int64_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+// Returns the peak resident memory of the process, in bytes.
+int64_t PeakRss() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return static_cast<int64_t>(usage.ru_maxrss) * 1024;
+}
+
+benchmark::Counter Bytes(int64_t bytes) {
+  return benchmark::Counter(bytes, benchmark::Counter::kDefaults,
+                            benchmark::Counter::kIs1024);
+}
+
+// Writes a C++ source of FUNCTIONS functions, each made of a chain of
+// DEPTH always inlined functions, to PATH.
+bool WriteSyntheticSource(const std::string &path, int functions, int depth) {
+  std::ofstream out(path);
+  out << "// Generated by symbolizer_benchmark.\n"
+      << "#define INLINE static inline __attribute__((always_inline))\n";
+  for (int f = 0; f < functions; ++f) {
+    out << "INLINE int f" << f << "_" << depth << "(int x) { return x * "
+        << f % 7 + 3 << " + " << f << "; }\n";
+    for (int d = depth - 1; d >= 0; --d) {
+      out << "INLINE int f" << f << "_" << d << "(int x) {\n"
+          << "  int y = x ^ " << d << ";\n"
+          << "  for (int i = 0; i < (x & " << d + 3 << "); ++i) y += i * x;\n"
+          << "  y = f" << f << "_" << d + 1 << "(y);\n"
+          << "  return y - (x >> " << d % 5 + 1 << ");\n"
+          << "}\n";
+    }
+    out << "__attribute__((noinline)) int f" << f << "(int x) { return f" << f
+        << "_0(x); }\n";
+  }
+  out << "int (*const kFunctions[])(int) = {\n";
+  for (int f = 0; f < functions; ++f) out << "  f" << f << ",\n";
+  out << "};\n"
+      << "int main(int argc, char **argv) {\n"
+      << "  int sum = argc;\n"
+      << "  for (int (*f)(int) : kFunctions) sum = f(sum);\n"
+      << "  return sum & 1;\n"
+      << "}\n";
+  out.close();
+  return !out.fail();
+}
+
+// Generates and compiles the synthetic binary. Returns its path, or an empty
+// string if it could not be built.
+std::string BuildSyntheticBinary() {
+  const std::string source =
+      absl::StrCat(absl::GetFlag(FLAGS_tmpdir), "/symbolizer_benchmark.cc");
+  const std::string binary =
+      absl::StrCat(absl::GetFlag(FLAGS_tmpdir), "/symbolizer_benchmark.binary");
+  if (!WriteSyntheticSource(source,
+                            absl::GetFlag(FLAGS_synthetic_functions),
+                            absl::GetFlag(FLAGS_synthetic_inline_depth))) {
+    fprintf(stderr, "Cannot write %s\n", source.c_str());
+    return "";
+  }
+  const std::string command = absl::StrCat(absl::GetFlag(FLAGS_cxx),
+                                           " -O2 -g -o ", binary, " ", source);
+  if (system(command.c_str()) != 0) {
+    fprintf(stderr, "Cannot build the synthetic binary: %s\n",
+            command.c_str());
+    return "";
+  }
+  return binary;
+}
+
+// A function of a binary, [start_addr, end_addr).
+struct Function {
+  std::string name;
+  uint64_t start_addr;
+  uint64_t end_addr;
+};
+
+// Returns the functions in SYMBOL_MAP that have a size.
+std::vector<Function> GetFunctions(const SymbolMap &symbol_map) {
+  std::vector<Function> functions;
+  for (const auto &name_addr : symbol_map.GetNameAddrMap()) {
+    const std::string *name;
+    uint64_t start_addr, end_addr;
+    if (symbol_map.GetSymbolInfoByAddr(name_addr.second, &name, &start_addr,
+                                       &end_addr) &&
+        end_addr > start_addr) {
+      functions.push_back({name_addr.first, start_addr, end_addr});
+    }
+  }
+  return functions;
+}
+
+void BM_Prepare(benchmark::State &state, const std::string &binary) {
+  int64_t rss = 0;
+  for (auto _ : state) {
+    const int64_t before = CurrentRss();
+    std::unique_ptr<Addr2line> addr2line(Addr2line::Create(binary));
+    if (addr2line == nullptr) {
+      state.SkipWithError("Cannot read the debug info");
+      break;
+    }
+    rss = std::max(rss, CurrentRss() - before);
+  }
+  state.counters["rss"] = Bytes(rss);
+  state.counters["peak_rss"] = Bytes(PeakRss());
+}
+
+void BM_GetInlineStack(benchmark::State &state, const std::string &binary) {
+  std::unique_ptr<Addr2line> addr2line(Addr2line::Create(binary));
+  if (addr2line == nullptr) {
+    state.SkipWithError("Cannot read the debug info");
+    return;
+  }
+  SymbolMap symbol_map(binary);
+  std::vector<uint64_t> addresses;
+  for (const Function &function : GetFunctions(symbol_map)) {
+    for (uint64_t addr = function.start_addr; addr < function.end_addr;
+         ++addr) {
+      addresses.push_back(addr);
+    }
+  }
+  if (addresses.empty()) {
+    state.SkipWithError("No functions");
+    return;
+  }
+  size_t next = 0;
+  SourceStack stack;
+  for (auto _ : state) {
+    stack.clear();
+    addr2line->GetInlineStack(addresses[next], &stack);
+    benchmark::DoNotOptimize(stack.data());
+    if (++next == addresses.size()) next = 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["peak_rss"] = Bytes(PeakRss());
+}
+
+void BM_InstructionMap(benchmark::State &state, const std::string &binary) {
+  std::unique_ptr<Addr2line> addr2line(Addr2line::Create(binary));
+  if (addr2line == nullptr) {
+    state.SkipWithError("Cannot read the debug info");
+    return;
+  }
+  SymbolMap symbol_map(binary);
+  const std::vector<Function> functions = GetFunctions(symbol_map);
+  if (functions.empty()) {
+    state.SkipWithError("No functions");
+    return;
+  }
+  for (const Function &function : functions) {
+    symbol_map.AddSymbol(function.name);
+  }
+  InstructionMap inst_map(addr2line.get(), &symbol_map);
+  size_t next = 0;
+  uint64_t bytes = 0;
+  for (auto _ : state) {
+    const Function &function = functions[next];
+    inst_map.BuildPerFunctionInstructionMap(function.name, function.start_addr,
+                                            function.end_addr);
+    bytes += function.end_addr - function.start_addr;
+    if (++next == functions.size()) next = 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["bytes_per_function"] =
+      static_cast<double>(bytes) / state.iterations();
+  state.counters["peak_rss"] = Bytes(PeakRss());
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  std::vector<std::pair<std::string, std::string>> binaries;
+  for (const char *name : {"test.binary", "test.fs.binary",
+                           "llvm_function_samples.binary"}) {
+    binaries.emplace_back(
+        name, absl::StrCat(absl::GetFlag(FLAGS_testdata_dir), "/", name));
+  }
+  const std::string synthetic = BuildSyntheticBinary();
+  if (!synthetic.empty()) binaries.emplace_back("synthetic", synthetic);
+
+  for (const auto &name_path : binaries) {
+    const std::string &name = name_path.first;
+    const std::string &path = name_path.second;
+    benchmark::RegisterBenchmark(
+        absl::StrCat(kSymbolizer, "/Prepare/", name).c_str(), BM_Prepare,
+        path)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(
+        absl::StrCat(kSymbolizer, "/GetInlineStack/", name).c_str(),
+        BM_GetInlineStack, path);
+    benchmark::RegisterBenchmark(
+        absl::StrCat(kSymbolizer, "/InstructionMap/", name).c_str(),
+        BM_InstructionMap, path)
+        ->Unit(benchmark::kMicrosecond);
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
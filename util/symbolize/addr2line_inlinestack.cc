@@ -41,6 +41,23 @@ bool SubprogramContains(
   }
   return true;
 }
+
+// Returns true if FORM gives an address rather than an offset from the
+// low pc, for DW_AT_high_pc.
+bool IsAddressForm(devtools_crosstool_autofdo::DwarfForm form) {
+  switch (form) {
+    case devtools_crosstool_autofdo::DW_FORM_addr:
+    case devtools_crosstool_autofdo::DW_FORM_GNU_addr_index:
+    case devtools_crosstool_autofdo::DW_FORM_addrx:
+    case devtools_crosstool_autofdo::DW_FORM_addrx1:
+    case devtools_crosstool_autofdo::DW_FORM_addrx2:
+    case devtools_crosstool_autofdo::DW_FORM_addrx3:
+    case devtools_crosstool_autofdo::DW_FORM_addrx4:
+      return true;
+    default:
+      return false;
+  }
+}
 }  // namespace
 
 namespace devtools_crosstool_autofdo {
@@ -98,10 +115,12 @@ bool InlineStackHandler::StartCompilationUnit(uint64 offset,
                                               uint8 /*address_size*/,
                                               uint8 /*offset_size*/,
                                               uint64 /*cu_length*/,
-                                              uint8 /*dwarf_version*/) {
+                                              uint8 dwarf_version) {
   CHECK(subprogram_stack_.empty());
   compilation_unit_offset_ = offset;
   compilation_unit_base_ = 0;
+  compilation_unit_addr_base_ = 0;
+  dwarf_version_ = dwarf_version;
   have_two_level_line_tables_ = false;
   subprogram_added_by_cu_ = false;
   if (input_file_index_ == -1) {
@@ -216,6 +235,31 @@ bool InlineStackHandler::StartDIE(uint64 offset,
   }
 }
 
+bool InlineStackHandler::WantChildren(uint64 offset, enum DwarfTag tag) {
+  switch (tag) {
+    case DW_TAG_compile_unit:
+      // Two-level line tables hold the inline call information, no DIE
+      // below the unit is of interest then.
+      return !have_two_level_line_tables_;
+    // These never have subprograms below them.  Namespaces, types that may
+    // have member functions and lexical blocks do, and subprograms that
+    // are not sampled are still read: the subprograms they hold may be the
+    // DW_AT_specification or DW_AT_abstract_origin of sampled ones.
+    case DW_TAG_array_type:
+    case DW_TAG_enumeration_type:
+    case DW_TAG_subroutine_type:
+    case DW_TAG_formal_parameter:
+    case DW_TAG_variable:
+    case DW_TAG_GNU_template_parameter_pack:
+    case DW_TAG_GNU_formal_parameter_pack:
+    case DW_TAG_GNU_call_site:
+    case DW_TAG_call_site:
+      return false;
+    default:
+      return true;
+  }
+}
+
 void InlineStackHandler::EndDIE(uint64 offset) {
   DwarfTag die = die_stack_.back();
   die_stack_.pop_back();
@@ -261,7 +305,8 @@ void InlineStackHandler::ProcessAttributeUnsigned(
   if (!subprogram_stack_.empty()) {
     switch (attr) {
       case DW_AT_call_file: {
-        if (data == 0 || data >= file_names_->size()) {
+        // File 0 is the primary source file from DWARF 5 on.
+        if ((data == 0 && dwarf_version_ < 5) || data >= file_names_->size()) {
           LOG(WARNING) << "unexpected reference to file_num " << data;
           break;
         }
@@ -284,13 +329,17 @@ void InlineStackHandler::ProcessAttributeUnsigned(
       case DW_AT_call_line:
         CHECK(form == DW_FORM_data1 ||
               form == DW_FORM_data2 ||
-              form == DW_FORM_data4);
+              form == DW_FORM_data4 ||
+              form == DW_FORM_udata ||
+              form == DW_FORM_implicit_const);
         subprogram_stack_.back()->set_callsite_line(data);
         break;
       case DW_AT_GNU_discriminator:
         CHECK(form == DW_FORM_data1 ||
               form == DW_FORM_data2 ||
-              form == DW_FORM_data4);
+              form == DW_FORM_data4 ||
+              form == DW_FORM_udata ||
+              form == DW_FORM_implicit_const);
         subprogram_stack_.back()->set_callsite_discr(data);
         break;
       case DW_AT_abstract_origin:
@@ -330,12 +379,18 @@ void InlineStackHandler::ProcessAttributeUnsigned(
         break;
       case DW_AT_high_pc:
         subprogram_stack_.back()->SetSingletonRangeHigh(
-            data, form != DW_FORM_addr);
+            data, !IsAddressForm(form));
         break;
       case DW_AT_ranges: {
         CHECK_EQ(0, subprogram_stack_.back()->address_ranges()->size());
         AddressRangeList::RangeList ranges;
-        address_ranges_->ReadRangeList(data, compilation_unit_base_, &ranges);
+        if (dwarf_version_ >= 5) {
+          address_ranges_->ReadRngList(data, compilation_unit_base_,
+                                       compilation_unit_addr_base_, &ranges);
+        } else {
+          address_ranges_->ReadRangeList(data, compilation_unit_base_,
+                                         &ranges);
+        }
 
         if (subprogram_stack_.size() == 1) {
           if (sampled_functions_ != NULL) {
@@ -376,6 +431,9 @@ void InlineStackHandler::ProcessAttributeUnsigned(
       case DW_AT_low_pc:
         compilation_unit_base_ = data;
         break;
+      case DW_AT_addr_base:
+        compilation_unit_addr_base_ = data;
+        break;
       case DW_AT_stmt_list:
         {
           SectionMap::const_iterator iter =
@@ -583,6 +641,8 @@ void InlineStackHandler::PopulateSubprogramsByAddress() {
           *subprog->address_ranges(), subprog);
   }
 
+  subprograms_by_address_.Freeze();
+
   // Clear this vector to save some memory
   subprogram_insert_order_.clear();
   if (overlap_count_ > 0) {
@@ -590,6 +650,44 @@ void InlineStackHandler::PopulateSubprogramsByAddress() {
   }
 }
 
+void InlineStackHandler::Merge(InlineStackHandler *other) {
+  CHECK(subprogram_stack_.empty());
+  CHECK(other->subprogram_stack_.empty());
+  if (input_file_index_ == -1) {
+    input_file_index_ = 0;
+    subprograms_by_offset_maps_.push_back(new SubprogramsByOffsetMap);
+  }
+  for (int i = 0; i < other->subprograms_by_offset_maps_.size(); ++i) {
+    SubprogramsByOffsetMap *other_map = other->subprograms_by_offset_maps_[i];
+    if (i == 0) {
+      // Offsets into the binary's own .debug_info are unique across
+      // compilation units, so these share the first map.
+      subprograms_by_offset_maps_[0]->insert(other_map->begin(),
+                                             other_map->end());
+      delete other_map;
+    } else {
+      // Each split compilation unit has a map of its own.
+      const int index = subprograms_by_offset_maps_.size();
+      for (const auto &offset_subprogram : *other_map)
+        offset_subprogram.second->set_input_file_index(index);
+      subprograms_by_offset_maps_.push_back(other_map);
+    }
+  }
+  other->subprograms_by_offset_maps_.clear();
+  other->input_file_index_ = -1;
+
+  subprogram_insert_order_.insert(subprogram_insert_order_.end(),
+                                  other->subprogram_insert_order_.begin(),
+                                  other->subprogram_insert_order_.end());
+  other->subprogram_insert_order_.clear();
+  compilation_unit_comp_dir_.insert(compilation_unit_comp_dir_.end(),
+                                    other->compilation_unit_comp_dir_.begin(),
+                                    other->compilation_unit_comp_dir_.end());
+  other->compilation_unit_comp_dir_.clear();
+  overlap_count_ += other->overlap_count_;
+  other->overlap_count_ = 0;
+}
+
 AddressRangeList::RangeList InlineStackHandler::SortAndMerge(
     AddressRangeList::RangeList rangelist) {
   AddressRangeList::RangeList merged;
@@ -620,6 +718,10 @@ const SubprogramInfo *InlineStackHandler::GetSubprogramForAddress(
     return NULL;
 }
 
+uint64 InlineStackHandler::GetSubprogramRangeEnd(uint64 address) const {
+  return subprograms_by_address_.NextBoundary(address);
+}
+
 const SubprogramInfo *InlineStackHandler::GetDeclaration(
     const SubprogramInfo *subprog) const {
   const int input_file_index = subprog->input_file_index();
@@ -59,6 +59,7 @@ class SubprogramInfo {
         used_(false) { }
 
   const int input_file_index() const { return input_file_index_; }
+  void set_input_file_index(int index) { input_file_index_ = index; }
 
   const uint64 offset() const { return offset_; }
   const SubprogramInfo *parent() const { return parent_; }
@@ -177,7 +178,7 @@ class InlineStackHandler: public Dwarf2Handler {
         input_file_index_(-1), subprograms_by_offset_maps_(),
         compilation_unit_comp_dir_(), sampled_functions_(sampled_functions),
         overlap_count_(0), have_two_level_line_tables_(false),
-        subprogram_added_by_cu_(false)
+        subprogram_added_by_cu_(false), dwarf_version_(0)
   { }
 
   virtual bool StartCompilationUnit(uint64 offset, uint8 address_size,
@@ -193,6 +194,8 @@ class InlineStackHandler: public Dwarf2Handler {
   virtual bool StartDIE(uint64 offset, enum DwarfTag tag,
                         const AttributeList& attrs);
 
+  bool WantChildren(uint64 offset, enum DwarfTag tag) override;
+
   virtual void EndDIE(uint64 offset);
 
   virtual void ProcessAttributeString(uint64 offset,
@@ -220,6 +223,10 @@ class InlineStackHandler: public Dwarf2Handler {
 
   const SubprogramInfo *GetSubprogramForAddress(uint64 address);
 
+  // Returns the first address above ADDRESS for which
+  // GetSubprogramForAddress may return another subprogram.
+  uint64 GetSubprogramRangeEnd(uint64 address) const;
+
   const SubprogramInfo *GetDeclaration(const SubprogramInfo *subprog) const;
 
   const SubprogramInfo *GetAbstractOrigin(const SubprogramInfo *subprog) const;
@@ -232,6 +239,11 @@ class InlineStackHandler: public Dwarf2Handler {
 
   void PopulateSubprogramsByAddress();
 
+  // Takes over all subprograms read by OTHER, which must have read
+  // compilation units that follow the ones read by this handler.
+  // Must be called before PopulateSubprogramsByAddress.
+  void Merge(InlineStackHandler *other);
+
   ~InlineStackHandler();
 
  private:
@@ -263,6 +275,9 @@ class InlineStackHandler: public Dwarf2Handler {
   NonOverlappingRangeMap<SubprogramInfo*> subprograms_by_address_;
   uint64 compilation_unit_offset_;
   uint64 compilation_unit_base_;
+  // The DW_AT_addr_base of the compilation unit, for its DWARF 5 range
+  // lists.
+  uint64 compilation_unit_addr_base_;
   // The comp dir name may come from a .dwo file's string table, which
   // will be destroyed before we're done, so we need to copy it for
   // each compilation unit.  We need to keep a vector of all the
@@ -273,6 +288,9 @@ class InlineStackHandler: public Dwarf2Handler {
   int overlap_count_;
   bool have_two_level_line_tables_;
   bool subprogram_added_by_cu_;
+  // The version of the compilation unit, which tells where its
+  // DW_AT_ranges point to and whether file 0 is valid.
+  uint8 dwarf_version_;
 
   DISALLOW_COPY_AND_ASSIGN(InlineStackHandler);
 };
@@ -16,6 +16,7 @@
 #define AUTOFDO_SYMBOLIZE_BYTEREADER_INL_H__
 
 #include <stddef.h>
+#include <string.h>
 
 #include "base/common.h"
 #include "symbolize/bytereader.h"
@@ -36,6 +37,17 @@ inline uint16 ByteReader::ReadTwoBytes(const char* buffer) const {
   }
 }
 
+inline uint32 ByteReader::ReadThreeBytes(const char* buffer) const {
+  const uint32 buffer0 = static_cast<uint32>(buffer[0]) & 0xff;
+  const uint32 buffer1 = static_cast<uint32>(buffer[1]) & 0xff;
+  const uint32 buffer2 = static_cast<uint32>(buffer[2]) & 0xff;
+  if (endian_ == ENDIANNESS_LITTLE) {
+    return buffer0 | buffer1 << 8 | buffer2 << 16;
+  } else {
+    return buffer2 | buffer1 << 8 | buffer0 << 16;
+  }
+}
+
 inline uint64 ByteReader::ReadFourBytes(const char* buffer) const {
   const uint32 buffer0 = static_cast<uint32>(buffer[0]) & 0xff;
   const uint32 buffer1 = static_cast<uint32>(buffer[1]) & 0xff;
@@ -114,6 +126,66 @@ inline int64 ByteReader::ReadSignedLEB128(const char* buffer,
   return result;
 }
 
+// A LEB128 number of up to eight bytes can be decoded without a loop
+// from a little endian load of the eight bytes it starts: the first byte
+// with a clear high bit ends it, and the 7-bit groups of the bytes before
+// that one are packed together by three rounds of masks and shifts.
+
+/* static */
+inline bool ByteReader::ReadLEB128FromWord(const char* buffer, uint64* value,
+                                           size_t* len) {
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+  uint64 word;
+  memcpy(&word, buffer, sizeof(word));
+  const uint64 last_bytes = ~word & 0x8080808080808080ULL;
+  if (last_bytes == 0)
+    return false;
+  const int num_bits = __builtin_ctzll(last_bytes) + 1;
+  if (num_bits < 64)
+    word &= (1ULL << num_bits) - 1;
+  word &= 0x7f7f7f7f7f7f7f7fULL;
+  word = (word & 0x007f007f007f007fULL) | ((word & 0x7f007f007f007f00ULL) >> 1);
+  word = (word & 0x00003fff00003fffULL) | ((word & 0x3fff00003fff0000ULL) >> 2);
+  word = (word & 0x000000000fffffffULL) | ((word & 0x0fffffff00000000ULL) >> 4);
+  *value = word;
+  *len = num_bits / 8;
+  return true;
+#else
+  return false;
+#endif
+}
+
+inline uint64 ByteReader::ReadUnsignedLEB128(const char* buffer,
+                                             const char* buffer_end,
+                                             size_t* len) const {
+  // Most numbers in DWARF fit in a single byte.
+  if ((buffer[0] & 0x80) == 0) {
+    *len = 1;
+    return ReadOneByte(buffer);
+  }
+  uint64 result;
+  if (buffer_end - buffer >= 8 && ReadLEB128FromWord(buffer, &result, len))
+    return result;
+  return ReadUnsignedLEB128(buffer, len);
+}
+
+inline int64 ByteReader::ReadSignedLEB128(const char* buffer,
+                                          const char* buffer_end,
+                                          size_t* len) const {
+  if ((buffer[0] & 0x80) == 0) {
+    *len = 1;
+    // Sign extend from bit 6.
+    const uint64 byte = ReadOneByte(buffer);
+    return static_cast<int64>(byte << 57) >> 57;
+  }
+  uint64 result;
+  if (buffer_end - buffer >= 8 && ReadLEB128FromWord(buffer, &result, len)) {
+    const int shift = 64 - 7 * static_cast<int>(*len);
+    return static_cast<int64>(result << shift) >> shift;
+  }
+  return ReadSignedLEB128(buffer, len);
+}
+
 inline uint64 ByteReader::ReadOffset(const char* buffer) const {
   CHECK(this->offset_reader_);
   return (this->*offset_reader_)(buffer);
@@ -62,6 +62,10 @@ class ByteReader {
   // number.
   uint16 ReadTwoBytes(const char* buffer) const;
 
+  // Read three bytes from BUFFER and return it as an unsigned 32 bit
+  // number.  DWARF 5 has three byte string and address indexes.
+  uint32 ReadThreeBytes(const char* buffer) const;
+
   // Read four bytes from BUFFER and return it as an unsigned 32 bit
   // number.  This function returns a uint64 so that it is compatible
   // with ReadAddress and ReadOffset.  The number it returns will
@@ -82,6 +86,14 @@ class ByteReader {
   // signed 64 bit integer.  LEN is set to the length read.
   int64 ReadSignedLEB128(const char* buffer, size_t* len) const;
 
+  // Same as above, for a number in a buffer ending at BUFFER_END.
+  // When eight bytes are left before BUFFER_END, numbers of up to eight
+  // bytes are decoded from a single load instead of byte by byte.
+  uint64 ReadUnsignedLEB128(const char* buffer, const char* buffer_end,
+                            size_t* len) const;
+  int64 ReadSignedLEB128(const char* buffer, const char* buffer_end,
+                         size_t* len) const;
+
   // Read an offset from BUFFER and return it as an unsigned 64 bit
   // integer.  DWARF2/3 define offsets as either 4 or 8 bytes,
   // generally depending on the amount of DWARF2/3 info present.
@@ -97,6 +109,12 @@ class ByteReader {
   // Function pointer type for our address and offset readers.
   typedef uint64 (ByteReader::*AddressReader)(const char*) const;
 
+  // Decode the LEB128 number in the eight bytes at BUFFER into VALUE,
+  // without its sign extended, and set LEN to its length.  Returns false
+  // if the number is longer than eight bytes.
+  static bool ReadLEB128FromWord(const char* buffer, uint64* value,
+                                 size_t* len);
+
   // Read an offset from BUFFER and return it as an unsigned 64 bit
   // integer.  DWARF2/3 define offsets as either 4 or 8 bytes,
   // generally depending on the amount of DWARF2/3 info present.
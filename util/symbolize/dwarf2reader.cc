@@ -51,16 +51,41 @@ static uint64 ReadInitialLength(const char* start,
   return initial_length;
 }
 
+AbbrevTableCache::~AbbrevTableCache() {
+  for (map<const char*, AbbrevTable*>::iterator i = tables_.begin();
+       i != tables_.end(); ++i) {
+    delete i->second;
+  }
+}
+
+const AbbrevTable* AbbrevTableCache::Find(const char* abbrev_start) const {
+  map<const char*, AbbrevTable*>::const_iterator i =
+      tables_.find(abbrev_start);
+  return i == tables_.end() ? NULL : i->second;
+}
+
+const AbbrevTable* AbbrevTableCache::Add(const char* abbrev_start,
+                                         AbbrevTable* table) {
+  AbbrevTable*& entry = tables_[abbrev_start];
+  CHECK(entry == NULL);
+  entry = table;
+  return table;
+}
+
 CompilationUnit::CompilationUnit(const string& path,
                                  const SectionMap& sections, uint64 offset,
                                  ByteReader* reader, Dwarf2Handler* handler)
     : path_(path), offset_from_section_start_(offset), reader_(reader),
       sections_(sections), handler_(handler), abbrevs_(NULL),
+      abbrev_cache_(&own_abbrev_cache_),
       string_buffer_(NULL), string_buffer_length_(0),
+      line_string_buffer_(NULL), line_string_buffer_length_(0),
       str_offsets_buffer_(NULL), str_offsets_buffer_length_(0),
       addr_buffer_(NULL), addr_buffer_length_(0),
+      rnglists_buffer_(NULL), rnglists_buffer_length_(0),
       is_split_dwarf_(false), dwo_id_(0), dwo_name_(),
       skeleton_dwo_id_(0), ranges_base_(0), addr_base_(0),
+      str_offsets_base_(0), rnglists_base_(0),
       have_checked_for_dwp_(false), dwp_path_(),
       dwp_byte_reader_(NULL), dwp_reader_(NULL), malformed_(false) {}
 
@@ -68,17 +93,20 @@ CompilationUnit::CompilationUnit(const string& path, const string& dwp_path,
                                  const SectionMap& sections, uint64 offset,
                                  ByteReader* reader, Dwarf2Handler* handler)
     : path_(path), offset_from_section_start_(offset), reader_(reader),
-      sections_(sections), handler_(handler), abbrevs_(),
+      sections_(sections), handler_(handler), abbrevs_(NULL),
+      abbrev_cache_(&own_abbrev_cache_),
       string_buffer_(NULL), string_buffer_length_(0),
+      line_string_buffer_(NULL), line_string_buffer_length_(0),
       str_offsets_buffer_(NULL), str_offsets_buffer_length_(0),
       addr_buffer_(NULL), addr_buffer_length_(0),
+      rnglists_buffer_(NULL), rnglists_buffer_length_(0),
       is_split_dwarf_(false), dwo_id_(0), dwo_name_(),
       skeleton_dwo_id_(0), ranges_base_(0), addr_base_(0),
+      str_offsets_base_(0), rnglists_base_(0),
       have_checked_for_dwp_(false), dwp_path_(dwp_path),
       dwp_byte_reader_(NULL), dwp_reader_(NULL), malformed_(false) {}
 
 CompilationUnit::~CompilationUnit() {
-  if (abbrevs_) delete abbrevs_;
   if (dwp_reader_) delete dwp_reader_;
   if (dwp_byte_reader_) delete dwp_byte_reader_;
 }
@@ -103,6 +131,65 @@ void CompilationUnit::SetSplitDwarf(const char* addr_buffer,
   skeleton_dwo_id_ = dwo_id;
 }
 
+// Adds the size of an attribute of FORM to the fixed size of ABBREV, or
+// clears its has_fixed_size if that size depends on the attribute data.
+static void AddFormSize(enum DwarfForm form, Abbrev* abbrev) {
+  switch (form) {
+    case DW_FORM_flag_present:
+      break;
+    case DW_FORM_data1:
+    case DW_FORM_flag:
+    case DW_FORM_ref1:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+      abbrev->fixed_size += 1;
+      break;
+    case DW_FORM_ref2:
+    case DW_FORM_data2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+      abbrev->fixed_size += 2;
+      break;
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+      abbrev->fixed_size += 3;
+      break;
+    case DW_FORM_ref4:
+    case DW_FORM_data4:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+      abbrev->fixed_size += 4;
+      break;
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_data8:
+    case DW_FORM_ref_sup8:
+      abbrev->fixed_size += 8;
+      break;
+    case DW_FORM_data16:
+      abbrev->fixed_size += 16;
+      break;
+    case DW_FORM_implicit_const:
+      break;
+    case DW_FORM_addr:
+      abbrev->num_addresses++;
+      break;
+    case DW_FORM_ref_addr:
+      abbrev->num_ref_addrs++;
+      break;
+    case DW_FORM_strp:
+    case DW_FORM_sec_offset:
+    case DW_FORM_line_strp:
+    case DW_FORM_strp_sup:
+      abbrev->num_offsets++;
+      break;
+    default:
+      abbrev->has_fixed_size = false;
+      break;
+  }
+}
+
 // Read a DWARF2/3 abbreviation section.
 // Each abbrev consists of a abbreviation number, a tag, a byte
 // specifying whether the tag has children, and a list of
@@ -119,28 +206,36 @@ void CompilationUnit::ReadAbbrevs() {
   SectionMap::const_iterator iter = sections_.find(".debug_abbrev");
   CHECK(iter != sections_.end());
 
-  if (abbrevs_) {
-    delete abbrevs_;
-  }
-  abbrevs_ = new vector<Abbrev>;
-  abbrevs_->resize(1);
+  // Units sharing the table at our abbrev offset may have read it.
+  const char* abbrev_start = iter->second.first +
+                                      header_.abbrev_offset;
+  abbrevs_ = abbrev_cache_->Find(abbrev_start);
+  if (abbrevs_)
+    return;
+
+  AbbrevTable* abbrevs = new AbbrevTable;
+  abbrevs->resize(1);
 
   // The only way to CHECK whether we are reading over the end of the
   // buffer would be to first compute the size of the leb128 data by
   // reading it, then go back and read it again.
-  const char* abbrev_start = iter->second.first +
-                                      header_.abbrev_offset;
   const char* abbrevptr = abbrev_start;
   const uint64 abbrev_length = iter->second.second - header_.abbrev_offset;
 
   while (1) {
-    CompilationUnit::Abbrev abbrev;
+    Abbrev abbrev;
     size_t len;
     const uint32 number = reader_->ReadUnsignedLEB128(abbrevptr, &len);
 
     if (number == 0)
       break;
     abbrev.number = number;
+    abbrev.has_fixed_size = true;
+    abbrev.fixed_size = 0;
+    abbrev.num_addresses = 0;
+    abbrev.num_offsets = 0;
+    abbrev.num_ref_addrs = 0;
+    abbrev.sibling_index = -1;
     abbrevptr += len;
 
     DCHECK(abbrevptr < abbrev_start + abbrev_length);
@@ -167,16 +262,33 @@ void CompilationUnit::ReadAbbrevs() {
       const enum DwarfAttribute name =
         static_cast<enum DwarfAttribute>(nametemp);
       const enum DwarfForm form = static_cast<enum DwarfForm>(formtemp);
+      if (form == DW_FORM_implicit_const) {
+        abbrev.implicit_consts.push_back(
+            reader_->ReadSignedLEB128(abbrevptr, &len));
+        abbrevptr += len;
+      }
+      if (name == DW_AT_sibling)
+        abbrev.sibling_index = abbrev.attributes.size();
+      AddFormSize(form, &abbrev);
       abbrev.attributes.push_back(std::make_pair(name, form));
     }
-    CHECK(abbrev.number == abbrevs_->size());
-    abbrevs_->push_back(abbrev);
+    CHECK(abbrev.number == abbrevs->size());
+    abbrevs->push_back(abbrev);
   }
+  abbrevs_ = abbrev_cache_->Add(abbrev_start, abbrevs);
 }
 
 // Skips a single DIE's attributes.
 const char* CompilationUnit::SkipDIE(const char* start,
                                               const Abbrev& abbrev) {
+  if (abbrev.has_fixed_size) {
+    const uint64 ref_addr_size = header_.version == 2 ?
+        reader_->AddressSize() : reader_->OffsetSize();
+    return start + abbrev.fixed_size +
+        abbrev.num_addresses * reader_->AddressSize() +
+        abbrev.num_offsets * reader_->OffsetSize() +
+        abbrev.num_ref_addrs * ref_addr_size;
+  }
   for (AttributeList::const_iterator i = abbrev.attributes.begin();
        i != abbrev.attributes.end();
        i++)  {
@@ -185,15 +297,92 @@ const char* CompilationUnit::SkipDIE(const char* start,
   return start;
 }
 
+// Reads DW_AT_sibling, which is most often the first attribute.
+const char* CompilationUnit::FindSibling(const char* start,
+                                         const Abbrev& abbrev,
+                                         const char* end) {
+  if (abbrev.sibling_index < 0)
+    return NULL;
+  AttributeList::const_iterator attr = abbrev.attributes.begin();
+  for (int i = 0; i < abbrev.sibling_index; i++, attr++)
+    start = SkipAttribute(start, attr->second);
+
+  // References are relative to the unit, but for DW_FORM_ref_addr.
+  const char* base = buffer_;
+  uint64 offset;
+  size_t len;
+  switch (attr->second) {
+    case DW_FORM_ref1:
+      offset = reader_->ReadOneByte(start);
+      break;
+    case DW_FORM_ref2:
+      offset = reader_->ReadTwoBytes(start);
+      break;
+    case DW_FORM_ref4:
+      offset = reader_->ReadFourBytes(start);
+      break;
+    case DW_FORM_ref8:
+      offset = reader_->ReadEightBytes(start);
+      break;
+    case DW_FORM_ref_udata:
+      offset = reader_->ReadUnsignedLEB128(start, end, &len);
+      break;
+    case DW_FORM_ref_addr:
+      if (header_.version == 2)
+        offset = reader_->ReadAddress(start);
+      else
+        offset = reader_->ReadOffset(start);
+      if (offset < offset_from_section_start_)
+        return NULL;
+      offset -= offset_from_section_start_;
+      break;
+    default:
+      return NULL;
+  }
+  if (offset <= static_cast<uint64>(start - base) ||
+      offset > static_cast<uint64>(end - base))
+    return NULL;
+  return base + offset;
+}
+
+// Skips the DIEs of a subtree, jumping over the children of those that
+// have a DW_AT_sibling.
+const char* CompilationUnit::SkipChildren(const char* start,
+                                          const char* end) {
+  int depth = 1;
+  while (depth > 0 && start < end) {
+    size_t len;
+    const uint64 abbrev_num = reader_->ReadUnsignedLEB128(start, end, &len);
+    start += len;
+    if (abbrev_num == 0) {
+      depth--;
+      continue;
+    }
+
+    const Abbrev& abbrev = abbrevs_->at(abbrev_num);
+    if (abbrev.has_children) {
+      const char* sibling = FindSibling(start, abbrev, end);
+      if (sibling != NULL) {
+        start = sibling;
+        continue;
+      }
+      depth++;
+    }
+    start = SkipDIE(start, abbrev);
+  }
+  return start;
+}
+
 // Skips a single attribute form's data.
 const char* CompilationUnit::SkipAttribute(const char* start,
                                                     enum DwarfForm form) {
+  const char* buffer_end = buffer_ + buffer_length_;
   size_t len;
 
   switch (form) {
     case DW_FORM_indirect:
-      form = static_cast<enum DwarfForm>(reader_->ReadUnsignedLEB128(start,
-                                                                     &len));
+      form = static_cast<enum DwarfForm>(
+          reader_->ReadUnsignedLEB128(start, buffer_end, &len));
       start += len;
       return SkipAttribute(start, form);
       break;
@@ -202,24 +391,43 @@ const char* CompilationUnit::SkipAttribute(const char* start,
       return start;
       break;
 
+    case DW_FORM_implicit_const:
+      return start;
+      break;
+
     case DW_FORM_data1:
     case DW_FORM_flag:
     case DW_FORM_ref1:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
       return start + 1;
       break;
     case DW_FORM_ref2:
     case DW_FORM_data2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
       return start + 2;
       break;
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+      return start + 3;
+      break;
     case DW_FORM_ref4:
     case DW_FORM_data4:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
       return start + 4;
       break;
     case DW_FORM_ref8:
     case DW_FORM_ref_sig8:
     case DW_FORM_data8:
+    case DW_FORM_ref_sup8:
       return start + 8;
       break;
+    case DW_FORM_data16:
+      return start + 16;
+      break;
     case DW_FORM_string:
       return start + strlen(start) + 1;
       break;
@@ -227,12 +435,16 @@ const char* CompilationUnit::SkipAttribute(const char* start,
     case DW_FORM_ref_udata:
     case DW_FORM_GNU_str_index:
     case DW_FORM_GNU_addr_index:
-      reader_->ReadUnsignedLEB128(start, &len);
+    case DW_FORM_strx:
+    case DW_FORM_addrx:
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+      reader_->ReadUnsignedLEB128(start, buffer_end, &len);
       return start + len;
       break;
 
     case DW_FORM_sdata:
-      reader_->ReadSignedLEB128(start, &len);
+      reader_->ReadSignedLEB128(start, buffer_end, &len);
       return start + len;
       break;
     case DW_FORM_addr:
@@ -259,12 +471,14 @@ const char* CompilationUnit::SkipAttribute(const char* start,
       break;
     case DW_FORM_block:
     case DW_FORM_exprloc: {
-      uint64 size = reader_->ReadUnsignedLEB128(start, &len);
+      uint64 size = reader_->ReadUnsignedLEB128(start, buffer_end, &len);
       return start + size + len;
     }
       break;
     case DW_FORM_strp:
     case DW_FORM_sec_offset:
+    case DW_FORM_line_strp:
+    case DW_FORM_strp_sup:
         return start + reader_->OffsetSize();
       break;
     default:
@@ -298,12 +512,26 @@ void CompilationUnit::ReadHeader() {
   }
 
   header_.version = reader_->ReadTwoBytes(headerptr);
-  if (header_.version < 2 || header_.version > 4) {
+  if (header_.version < 2 || header_.version > 5) {
     malformed_ = true;
     return;
   }
   headerptr += 2;
 
+  // DWARF 5 adds a unit type and moves the address size before the
+  // abbrev offset.
+  header_.unit_type = DW_UT_compile;
+  if (header_.version >= 5) {
+    if (headerptr + 2 >= buffer_ + buffer_length_) {
+      malformed_ = true;
+      return;
+    }
+    header_.unit_type = reader_->ReadOneByte(headerptr);
+    headerptr += 1;
+    header_.address_size = reader_->ReadOneByte(headerptr);
+    headerptr += 1;
+  }
+
   if (headerptr + reader_->OffsetSize() >= buffer_ + buffer_length_) {
     malformed_ = true;
     return;
@@ -311,17 +539,39 @@ void CompilationUnit::ReadHeader() {
   header_.abbrev_offset = reader_->ReadOffset(headerptr);
   headerptr += reader_->OffsetSize();
 
-  if (headerptr + 1 >= buffer_ + buffer_length_) {
-    malformed_ = true;
-    return;
+  if (header_.version < 5) {
+    if (headerptr + 1 >= buffer_ + buffer_length_) {
+      malformed_ = true;
+      return;
+    }
+    header_.address_size = reader_->ReadOneByte(headerptr);
+    headerptr += 1;
   }
-  header_.address_size = reader_->ReadOneByte(headerptr);
   if (header_.address_size != 4 && header_.address_size != 8) {
     malformed_ = true;
     return;
   }
   reader_->SetAddressSize(header_.address_size);
-  headerptr += 1;
+
+  // Skeleton and split units then have their dwo_id, type units their
+  // type signature and type offset.
+  switch (header_.unit_type) {
+    case DW_UT_skeleton:
+    case DW_UT_split_compile:
+      if (headerptr + 8 >= buffer_ + buffer_length_) {
+        malformed_ = true;
+        return;
+      }
+      dwo_id_ = reader_->ReadEightBytes(headerptr);
+      headerptr += 8;
+      break;
+    case DW_UT_type:
+    case DW_UT_split_type:
+      headerptr += 8 + reader_->OffsetSize();
+      break;
+    default:
+      break;
+  }
 
   after_header_ = headerptr;
 
@@ -336,10 +586,8 @@ void CompilationUnit::ReadHeader() {
 }
 
 uint64 CompilationUnit::Start(uint64 offset) {
-  // Reset all members except for construction parameters and *dwp*.
-  if (abbrevs_) {
-    delete abbrevs_;
-  }
+  // Reset all members except for construction parameters, the
+  // abbreviation cache and *dwp*.
   abbrevs_ = NULL;
 
   offset_from_section_start_ = offset;
@@ -347,12 +595,18 @@ uint64 CompilationUnit::Start(uint64 offset) {
   string_buffer_ = NULL;
   string_buffer_length_ = 0;
 
+  line_string_buffer_ = NULL;
+  line_string_buffer_length_ = 0;
+
   str_offsets_buffer_ = NULL;
   str_offsets_buffer_length_ = 0;
 
   addr_buffer_ = NULL;
   addr_buffer_length_ = 0;
 
+  rnglists_buffer_ = NULL;
+  rnglists_buffer_length_ = 0;
+
   after_header_ = NULL;
   malformed_ = false;
 
@@ -362,6 +616,8 @@ uint64 CompilationUnit::Start(uint64 offset) {
 
   ranges_base_ = 0;
   addr_base_ = 0;
+  str_offsets_base_ = 0;
+  rnglists_base_ = 0;
 
   return Start();
 }
@@ -421,6 +677,13 @@ uint64 CompilationUnit::Start() {
     string_buffer_length_ = iter->second.second;
   }
 
+  // Set the line string section if we have one.
+  iter = sections_.find(".debug_line_str");
+  if (iter != sections_.end()) {
+    line_string_buffer_ = iter->second.first;
+    line_string_buffer_length_ = iter->second.second;
+  }
+
   // Set the string offsets section if we have one.
   iter = sections_.find(".debug_str_offsets");
   if (iter != sections_.end()) {
@@ -435,6 +698,16 @@ uint64 CompilationUnit::Start() {
     addr_buffer_length_ = iter->second.second;
   }
 
+  // Set the range list section if we have one.
+  iter = sections_.find(".debug_rnglists");
+  if (iter != sections_.end()) {
+    rnglists_buffer_ = iter->second.first;
+    rnglists_buffer_length_ = iter->second.second;
+  }
+
+  if (header_.version >= 5)
+    ReadUnitBases();
+
   // Now that we have our abbreviations, start processing DIE's.
   ProcessDIEs();
 
@@ -451,20 +724,101 @@ uint64 CompilationUnit::Start() {
   return ourlength;
 }
 
+// The bases are usually the last attributes of the unit DIE, after
+// strings and addresses indexed through them.
+void CompilationUnit::ReadUnitBases() {
+  const char* start = after_header_;
+  const char* buffer_end = buffer_ + buffer_length_;
+  size_t len;
+  const uint64 abbrev_num = reader_->ReadUnsignedLEB128(start, buffer_end,
+                                                        &len);
+  if (abbrev_num == 0 || abbrev_num >= abbrevs_->size())
+    return;
+  start += len;
+
+  const Abbrev& abbrev = (*abbrevs_)[abbrev_num];
+  for (AttributeList::const_iterator i = abbrev.attributes.begin();
+       i != abbrev.attributes.end();
+       i++)  {
+    if (i->second == DW_FORM_sec_offset) {
+      switch (i->first) {
+        case DW_AT_str_offsets_base:
+          str_offsets_base_ = reader_->ReadOffset(start);
+          break;
+        case DW_AT_addr_base:
+          addr_base_ = reader_->ReadOffset(start);
+          break;
+        case DW_AT_rnglists_base:
+          rnglists_base_ = reader_->ReadOffset(start);
+          break;
+        default:
+          break;
+      }
+    }
+    start = SkipAttribute(start, i->second);
+  }
+}
+
+const char* CompilationUnit::ReadIndexedString(uint64 index) {
+  const uint64 entry = str_offsets_base_ + index * reader_->OffsetSize();
+  if (str_offsets_buffer_ == NULL ||
+      entry + reader_->OffsetSize() > str_offsets_buffer_length_) {
+    LOG(WARNING) << "string index is out of range.  index=" << index
+                 << " str_offsets_buffer_length_="
+                 << str_offsets_buffer_length_;
+    return NULL;
+  }
+
+  const uint64 offset = reader_->ReadOffset(str_offsets_buffer_ + entry);
+  if (offset >= string_buffer_length_) {
+    LOG(WARNING) << "offset is out of range.  offset=" << offset
+                 << " string_buffer_length_=" << string_buffer_length_;
+    return NULL;
+  }
+  return string_buffer_ + offset;
+}
+
+bool CompilationUnit::ReadIndexedAddress(uint64 index, uint64* address) {
+  const uint64 entry = addr_base_ + index * reader_->AddressSize();
+  if (addr_buffer_ == NULL ||
+      entry + reader_->AddressSize() > addr_buffer_length_) {
+    LOG(WARNING) << "address index is out of range.  index=" << index
+                 << " addr_buffer_length_=" << addr_buffer_length_;
+    return false;
+  }
+  *address = reader_->ReadAddress(addr_buffer_ + entry);
+  return true;
+}
+
+// The offsets in the table are relative to the table, which starts at the
+// DW_AT_rnglists_base of the unit.
+bool CompilationUnit::ReadRangeListOffset(uint64 index, uint64* offset) {
+  const uint64 entry = rnglists_base_ + index * reader_->OffsetSize();
+  if (rnglists_buffer_ == NULL ||
+      entry + reader_->OffsetSize() > rnglists_buffer_length_) {
+    LOG(WARNING) << "range list index is out of range.  index=" << index
+                 << " rnglists_buffer_length_=" << rnglists_buffer_length_;
+    return false;
+  }
+  *offset = rnglists_base_ + reader_->ReadOffset(rnglists_buffer_ + entry);
+  return true;
+}
+
 // If one really wanted, you could merge SkipAttribute and
 // ProcessAttribute
 // This is all boring data manipulation and calling of the handler.
 const char* CompilationUnit::ProcessAttribute(
     uint64 dieoffset, const char* start, enum DwarfAttribute attr,
     enum DwarfForm form) {
+  const char* buffer_end = buffer_ + buffer_length_;
   size_t len;
 
   switch (form) {
     // DW_FORM_indirect is never used because it is such a space
     // waster.
     case DW_FORM_indirect:
-      form = static_cast<enum DwarfForm>(reader_->ReadUnsignedLEB128(start,
-                                                                     &len));
+      form = static_cast<enum DwarfForm>(
+          reader_->ReadUnsignedLEB128(start, buffer_end, &len));
       start += len;
       return ProcessAttribute(dieoffset, start, attr, form);
       break;
@@ -488,6 +842,7 @@ const char* CompilationUnit::ProcessAttribute(
       break;
     case DW_FORM_ref4:
     case DW_FORM_data4:
+    case DW_FORM_ref_sup4:
       ProcessAttributeUnsigned(dieoffset, attr, form,
                                          reader_->ReadFourBytes(start));
       return start + 4;
@@ -495,10 +850,15 @@ const char* CompilationUnit::ProcessAttribute(
     case DW_FORM_ref8:
     case DW_FORM_ref_sig8:
     case DW_FORM_data8:
+    case DW_FORM_ref_sup8:
       ProcessAttributeUnsigned(dieoffset, attr, form,
                                          reader_->ReadEightBytes(start));
       return start + 8;
       break;
+    case DW_FORM_data16:
+      ProcessAttributeBuffer(dieoffset, attr, form, start, 16);
+      return start + 16;
+      break;
     case DW_FORM_string: {
       const char* str = start;
       ProcessAttributeString(dieoffset, attr, form,
@@ -509,14 +869,15 @@ const char* CompilationUnit::ProcessAttribute(
     case DW_FORM_udata:
     case DW_FORM_ref_udata:
       ProcessAttributeUnsigned(dieoffset, attr, form,
-                                         reader_->ReadUnsignedLEB128(start,
-                                                                     &len));
+                                         reader_->ReadUnsignedLEB128(
+                                             start, buffer_end, &len));
       return start + len;
       break;
 
     case DW_FORM_sdata:
       ProcessAttributeSigned(dieoffset, attr, form,
-                                      reader_->ReadSignedLEB128(start, &len));
+                                      reader_->ReadSignedLEB128(
+                                          start, buffer_end, &len));
       return start + len;
       break;
     case DW_FORM_addr:
@@ -538,6 +899,7 @@ const char* CompilationUnit::ProcessAttribute(
       }
       break;
     case DW_FORM_sec_offset:
+    case DW_FORM_strp_sup:
       ProcessAttributeUnsigned(dieoffset, attr, form,
                                          reader_->ReadOffset(start));
       return start + reader_->OffsetSize();
@@ -566,7 +928,7 @@ const char* CompilationUnit::ProcessAttribute(
     }
     case DW_FORM_block:
     case DW_FORM_exprloc: {
-      uint64 datalen = reader_->ReadUnsignedLEB128(start, &len);
+      uint64 datalen = reader_->ReadUnsignedLEB128(start, buffer_end, &len);
       ProcessAttributeBuffer(dieoffset, attr, form, start + len,
                                       datalen);
       return start + datalen + len;
@@ -588,36 +950,107 @@ const char* CompilationUnit::ProcessAttribute(
       return start + reader_->OffsetSize();
       break;
     }
-    case DW_FORM_GNU_str_index: {
-      CHECK(string_buffer_ != NULL);
-      CHECK(str_offsets_buffer_ != NULL);
-
-      uint64 str_index = reader_->ReadUnsignedLEB128(start, &len);
-      const char* offset_ptr =
-          str_offsets_buffer_ + str_index * reader_->OffsetSize();
-      const uint64 offset = reader_->ReadOffset(offset_ptr);
-      if (offset >= string_buffer_length_) {
+    case DW_FORM_line_strp: {
+      const uint64 offset = reader_->ReadOffset(start);
+      if (offset >= line_string_buffer_length_) {
         LOG(WARNING) << "offset is out of range.  offset=" << offset
-                     << " string_buffer_length_=" << string_buffer_length_;
+                     << " line_string_buffer_length_="
+                     << line_string_buffer_length_;
         return NULL;
       }
 
-      const char* str = string_buffer_ + offset;
+      const char* str = line_string_buffer_ + offset;
+      ProcessAttributeString(dieoffset, attr, form,
+                                       str);
+      return start + reader_->OffsetSize();
+      break;
+    }
+    case DW_FORM_GNU_str_index:
+    case DW_FORM_strx:
+    case DW_FORM_strx1:
+    case DW_FORM_strx2:
+    case DW_FORM_strx3:
+    case DW_FORM_strx4: {
+      uint64 str_index;
+      switch (form) {
+        case DW_FORM_strx1:
+          str_index = reader_->ReadOneByte(start);
+          len = 1;
+          break;
+        case DW_FORM_strx2:
+          str_index = reader_->ReadTwoBytes(start);
+          len = 2;
+          break;
+        case DW_FORM_strx3:
+          str_index = reader_->ReadThreeBytes(start);
+          len = 3;
+          break;
+        case DW_FORM_strx4:
+          str_index = reader_->ReadFourBytes(start);
+          len = 4;
+          break;
+        default:
+          str_index = reader_->ReadUnsignedLEB128(start, buffer_end, &len);
+          break;
+      }
+      const char* str = ReadIndexedString(str_index);
+      if (str == NULL)
+        return NULL;
       ProcessAttributeString(dieoffset, attr, form,
                                        str);
       return start + len;
       break;
     }
-    case DW_FORM_GNU_addr_index: {
-      CHECK(addr_buffer_ != NULL);
-      uint64 addr_index = reader_->ReadUnsignedLEB128(start, &len);
-      const char* addr_ptr =
-          addr_buffer_ + addr_base_ + addr_index * reader_->AddressSize();
-      ProcessAttributeUnsigned(dieoffset, attr, form,
-                                         reader_->ReadAddress(addr_ptr));
+    case DW_FORM_GNU_addr_index:
+    case DW_FORM_addrx:
+    case DW_FORM_addrx1:
+    case DW_FORM_addrx2:
+    case DW_FORM_addrx3:
+    case DW_FORM_addrx4: {
+      uint64 addr_index;
+      switch (form) {
+        case DW_FORM_addrx1:
+          addr_index = reader_->ReadOneByte(start);
+          len = 1;
+          break;
+        case DW_FORM_addrx2:
+          addr_index = reader_->ReadTwoBytes(start);
+          len = 2;
+          break;
+        case DW_FORM_addrx3:
+          addr_index = reader_->ReadThreeBytes(start);
+          len = 3;
+          break;
+        case DW_FORM_addrx4:
+          addr_index = reader_->ReadFourBytes(start);
+          len = 4;
+          break;
+        default:
+          addr_index = reader_->ReadUnsignedLEB128(start, buffer_end, &len);
+          break;
+      }
+      uint64 address;
+      if (!ReadIndexedAddress(addr_index, &address))
+        return NULL;
+      ProcessAttributeUnsigned(dieoffset, attr, form, address);
       return start + len;
       break;
     }
+    case DW_FORM_rnglistx: {
+      uint64 offset;
+      if (!ReadRangeListOffset(
+              reader_->ReadUnsignedLEB128(start, buffer_end, &len), &offset))
+        return NULL;
+      ProcessAttributeUnsigned(dieoffset, attr, form, offset);
+      return start + len;
+      break;
+    }
+    case DW_FORM_loclistx:
+      ProcessAttributeUnsigned(dieoffset, attr, form,
+                                         reader_->ReadUnsignedLEB128(
+                                             start, buffer_end, &len));
+      return start + len;
+      break;
     default:
       LOG(FATAL) << "Unhandled form type";
   }
@@ -628,9 +1061,21 @@ const char* CompilationUnit::ProcessAttribute(
 const char* CompilationUnit::ProcessDIE(uint64 dieoffset,
                                         const char* start,
                                         const Abbrev& abbrev) {
+  std::vector<int64>::const_iterator implicit_const =
+      abbrev.implicit_consts.begin();
   for (AttributeList::const_iterator i = abbrev.attributes.begin();
        i != abbrev.attributes.end();
        i++)  {
+    // Constants such as DW_AT_decl_line are given as unsigned whatever
+    // their form, so are non-negative implicit constants.
+    if (i->second == DW_FORM_implicit_const) {
+      const int64 value = *implicit_const++;
+      if (value >= 0)
+        ProcessAttributeUnsigned(dieoffset, i->first, i->second, value);
+      else
+        ProcessAttributeSigned(dieoffset, i->first, i->second, value);
+      continue;
+    }
     start = ProcessAttribute(dieoffset, start, i->first, i->second);
     if (start == NULL) {
       break;
@@ -666,14 +1111,16 @@ void CompilationUnit::ProcessDIEs() {
   else
     lengthstart += 4;
 
+  const char* buffer_end = buffer_ + buffer_length_;
+  const char* unit_end = lengthstart + header_.length;
   stack<uint64> die_stack;
 
-  while (dieptr < (lengthstart + header_.length)) {
+  while (dieptr < unit_end) {
     // We give the user the absolute offset from the beginning of
     // debug_info, since they need it to deal with ref_addr forms.
     uint64 absolute_offset = (dieptr - buffer_) + offset_from_section_start_;
 
-    uint64 abbrev_num = reader_->ReadUnsignedLEB128(dieptr, &len);
+    uint64 abbrev_num = reader_->ReadUnsignedLEB128(dieptr, buffer_end, &len);
 
     dieptr += len;
 
@@ -690,6 +1137,7 @@ void CompilationUnit::ProcessDIEs() {
 
     const Abbrev& abbrev = abbrevs_->at(abbrev_num);
     const enum DwarfTag tag = abbrev.tag;
+    const char* attributes = dieptr;
     if (!handler_->StartDIE(absolute_offset, tag, abbrev.attributes)) {
       dieptr = SkipDIE(dieptr, abbrev);
     } else {
@@ -699,7 +1147,12 @@ void CompilationUnit::ProcessDIEs() {
       }
     }
 
-    if (abbrev.has_children) {
+    if (abbrev.has_children &&
+        !handler_->WantChildren(absolute_offset, tag)) {
+      const char* sibling = FindSibling(attributes, abbrev, unit_end);
+      dieptr = sibling != NULL ? sibling : SkipChildren(dieptr, unit_end);
+      handler_->EndDIE(absolute_offset);
+    } else if (abbrev.has_children) {
       die_stack.push(absolute_offset);
     } else {
       handler_->EndDIE(absolute_offset);
@@ -1086,14 +1539,93 @@ bool LineInfo::ReadUnsignedForm(uint32 form, uint64* value,
     const char** lineptr) {
   size_t len;
 
-  if (form == DW_FORM_udata) {
-    *value = reader_->ReadUnsignedLEB128(*lineptr, &len);
-    if (!AdvanceLinePtr(len, lineptr)) {
+  switch (form) {
+    case DW_FORM_udata:
+      *value = reader_->ReadUnsignedLEB128(*lineptr, &len);
+      break;
+    case DW_FORM_data1:
+      *value = reader_->ReadOneByte(*lineptr);
+      len = 1;
+      break;
+    case DW_FORM_data2:
+      *value = reader_->ReadTwoBytes(*lineptr);
+      len = 2;
+      break;
+    case DW_FORM_data4:
+      *value = reader_->ReadFourBytes(*lineptr);
+      len = 4;
+      break;
+    case DW_FORM_data8:
+      *value = reader_->ReadEightBytes(*lineptr);
+      len = 8;
+      break;
+    default:
       return false;
-    }
-  } else {
+  }
+  return AdvanceLinePtr(len, lineptr);
+}
+
+bool LineInfo::SkipForm(uint32 form, const char** lineptr) {
+  size_t len;
+  uint64 value;
+
+  switch (form) {
+    case DW_FORM_string:
+      return AdvanceLinePtr(strlen(*lineptr) + 1, lineptr);
+    case DW_FORM_line_strp:
+    case DW_FORM_strp:
+      return AdvanceLinePtr(reader_->OffsetSize(), lineptr);
+    case DW_FORM_data16:
+      return AdvanceLinePtr(16, lineptr);
+    case DW_FORM_block:
+      value = reader_->ReadUnsignedLEB128(*lineptr, &len);
+      return AdvanceLinePtr(len + value, lineptr);
+    default:
+      return ReadUnsignedForm(form, &value, lineptr);
+  }
+}
+
+bool LineInfo::ReadEntryTable(bool directories, const char** lineptr) {
+  static const uint32 kMaxTypes = 8;
+  uint32 content_types[kMaxTypes];
+  uint32 content_forms[kMaxTypes];
+  uint32 format_count;
+  size_t len;
+
+  if (!ReadTypesAndForms(lineptr, content_types, content_forms,
+      kMaxTypes, &format_count)) {
     return false;
   }
+  uint64 entry_count = reader_->ReadUnsignedLEB128(*lineptr, &len);
+  if (!AdvanceLinePtr(len, lineptr)) {
+    return false;
+  }
+  for (uint32 row = 0; row < entry_count; ++row) {
+    const char* path = NULL;
+    uint64 dirindex = 0;
+    for (uint32 col = 0; col < format_count; ++col) {
+      bool ok;
+      if (content_types[col] == DW_LNCT_path) {
+        ok = ReadStringForm(content_forms[col], &path, lineptr);
+      } else if (content_types[col] == DW_LNCT_directory_index) {
+        ok = ReadUnsignedForm(content_forms[col], &dirindex, lineptr);
+      } else {
+        // The timestamp, size and MD5 of files are not used.
+        ok = SkipForm(content_forms[col], lineptr);
+      }
+      if (!ok) {
+        return false;
+      }
+    }
+    if (path == NULL) {
+      return false;
+    }
+    if (directories) {
+      handler_->DefineDir(path, row);
+    } else {
+      handler_->DefineFile(path, row, dirindex, 0, 0);
+    }
+  }
   return true;
 }
 
@@ -1127,12 +1659,20 @@ void LineInfo::ReadHeader() {
   if (!AdvanceLinePtr(2, &lineptr)) {
     return;
   }
-  if ((header_.version < 2 || header_.version > 4)
+  if ((header_.version < 2 || header_.version > 5)
       && header_.version != VERSION_TWO_LEVEL) {
     malformed_ = true;
     return;
   }
 
+  if (header_.version == 5) {
+    // The address size is that of the compilation unit, and there are
+    // no segments.
+    if (!AdvanceLinePtr(2, &lineptr)) {
+      return;
+    }
+  }
+
   header_.prologue_length = reader_->ReadOffset(lineptr);
   if (!AdvanceLinePtr(reader_->OffsetSize(), &lineptr)) {
     return;
@@ -1184,7 +1724,22 @@ void LineInfo::ReadHeader() {
     }
   }
 
-  if (header_.version != VERSION_TWO_LEVEL) {
+  if (header_.version == 5) {
+    // Directories and files are numbered from 0, which is the
+    // compilation directory and the primary source file.
+    if (!ReadEntryTable(true, &lineptr) ||
+        !ReadEntryTable(false, &lineptr)) {
+      malformed_ = true;
+      return;
+    }
+    lineptr = end_of_prologue_length + header_.prologue_length;
+    if (lineptr > buffer_ + buffer_length_) {
+      malformed_ = true;
+      return;
+    }
+    header_.logicals_offset = 0;
+    header_.actuals_offset = 0;
+  } else if (header_.version != VERSION_TWO_LEVEL) {
     // It is legal for the directory entry table to be empty.
     if (*lineptr) {
       uint32 dirindex = 1;
@@ -1397,12 +1952,29 @@ void LineInfo::ReadHeader() {
   after_header_ = lineptr;
 }
 
+/* static */
+inline void LineInfo::ProcessSpecialOpcode(
+    const struct LineInfoHeader &header,
+    uint8 opcode,
+    struct LineStateMachine* lsm) {
+  opcode -= header.opcode_base;
+  const int64 advance_address = (opcode / header.line_range)
+                                * header.min_insn_length;
+  const int64 advance_line = (opcode % header.line_range)
+                             + header.line_base;
+
+  lsm->address += advance_address;
+  lsm->line_num += advance_line;
+  lsm->basic_block = true;
+}
+
 /* static */
 bool LineInfo::ProcessOneOpcode(
     ByteReader* reader,
     LineInfoHandler* handler,
     const struct LineInfoHeader &header,
     const char* start,
+    const char* end,
     struct LineStateMachine* lsm,
     size_t* len,
     const LogicalsVector *logicals,
@@ -1416,15 +1988,7 @@ bool LineInfo::ProcessOneOpcode(
   // If the opcode is great than the opcode_base, it is a special
   // opcode. Most line programs consist mainly of special opcodes.
   if (opcode >= header.opcode_base) {
-    opcode -= header.opcode_base;
-    const int64 advance_address = (opcode / header.line_range)
-                                  * header.min_insn_length;
-    const int64 advance_line = (opcode % header.line_range)
-                               + header.line_base;
-
-    lsm->address += advance_address;
-    lsm->line_num += advance_line;
-    lsm->basic_block = true;
+    ProcessSpecialOpcode(header, opcode, lsm);
     *len = oplen;
     return true;
   }
@@ -1438,25 +2002,25 @@ bool LineInfo::ProcessOneOpcode(
     }
 
     case DW_LNS_advance_pc: {
-      uint64 advance_address = reader->ReadUnsignedLEB128(start, &templen);
+      uint64 advance_address = reader->ReadUnsignedLEB128(start, end, &templen);
       oplen += templen;
       lsm->address += header.min_insn_length * advance_address;
     }
       break;
     case DW_LNS_advance_line: {
-      const int64 advance_line = reader->ReadSignedLEB128(start, &templen);
+      const int64 advance_line = reader->ReadSignedLEB128(start, end, &templen);
       oplen += templen;
       lsm->line_num += advance_line;
     }
       break;
     case DW_LNS_set_file: {
-      const uint64 fileno = reader->ReadUnsignedLEB128(start, &templen);
+      const uint64 fileno = reader->ReadUnsignedLEB128(start, end, &templen);
       oplen += templen;
       lsm->file_num = fileno;
     }
       break;
     case DW_LNS_set_column: {
-      const uint64 colno = reader->ReadUnsignedLEB128(start, &templen);
+      const uint64 colno = reader->ReadUnsignedLEB128(start, end, &templen);
       oplen += templen;
       lsm->column_num = colno;
     }
@@ -1489,14 +2053,16 @@ bool LineInfo::ProcessOneOpcode(
       if (logicals != NULL && !is_actuals) {
         // We're reading the logicals table, so this is
         // DW_LNS_set_subprogram.
-        const uint64 subprog_num = reader->ReadUnsignedLEB128(start, &templen);
+        const uint64 subprog_num = reader->ReadUnsignedLEB128(start, end,
+                                                              &templen);
         oplen += templen;
         lsm->subprog_num = subprog_num;
         lsm->context = 0;
       } else if (logicals != NULL && is_actuals) {
         // We're reading the actuals table, so this is
         // DW_LNS_set_address_from_logical.
-        const int64 advance_line = reader->ReadSignedLEB128(start, &templen);
+        const int64 advance_line = reader->ReadSignedLEB128(start, end,
+                                                            &templen);
         oplen += templen;
         lsm->line_num += advance_line;
         if (lsm->line_num >= 1
@@ -1507,17 +2073,18 @@ bool LineInfo::ProcessOneOpcode(
         }
       } else {
         // Just skip the operand.
-        reader->ReadSignedLEB128(start, &templen);
+        reader->ReadSignedLEB128(start, end, &templen);
         oplen += templen;
         LOG(WARNING) << "DW_LNS_set_subprogram/set_address_from_logical "
             "opcode seen, but not in actuals table";
       }
       break;
     case DW_LNS_inlined_call: {
-      const int64 advance_line = reader->ReadSignedLEB128(start, &templen);
+      const int64 advance_line = reader->ReadSignedLEB128(start, end, &templen);
       oplen += templen;
       start += templen;
-      const int64 subprog_num = reader->ReadUnsignedLEB128(start, &templen);
+      const int64 subprog_num = reader->ReadUnsignedLEB128(start, end,
+                                                           &templen);
       oplen += templen;
       if (logicals != NULL && !is_actuals) {
         lsm->context = logicals->size() + advance_line;
@@ -1547,7 +2114,7 @@ bool LineInfo::ProcessOneOpcode(
       }
       break;
     case DW_LNS_extended_op: {
-      const size_t extended_op_len = reader->ReadUnsignedLEB128(start,
+      const size_t extended_op_len = reader->ReadUnsignedLEB128(start, end,
                                                                 &templen);
       start += templen;
       oplen += templen + extended_op_len;
@@ -1573,14 +2140,14 @@ bool LineInfo::ProcessOneOpcode(
           templen = strlen(filename) + 1;
           start += templen;
 
-          uint64 dirindex = reader->ReadUnsignedLEB128(start, &templen);
+          uint64 dirindex = reader->ReadUnsignedLEB128(start, end, &templen);
           start += templen;
 
-          const uint64 mod_time = reader->ReadUnsignedLEB128(start,
+          const uint64 mod_time = reader->ReadUnsignedLEB128(start, end,
                                                              &templen);
           start += templen;
 
-          const uint64 filelength = reader->ReadUnsignedLEB128(start,
+          const uint64 filelength = reader->ReadUnsignedLEB128(start, end,
                                                                &templen);
           start += templen;
 
@@ -1591,7 +2158,7 @@ bool LineInfo::ProcessOneOpcode(
         }
           break;
         case DW_LNE_set_discriminator: {
-          const uint64 discriminator = reader->ReadUnsignedLEB128(start,
+          const uint64 discriminator = reader->ReadUnsignedLEB128(start, end,
                                                                   &templen);
           lsm->discriminator = static_cast<uint32>(discriminator);
         }
@@ -1605,7 +2172,7 @@ bool LineInfo::ProcessOneOpcode(
       if (header.std_opcode_lengths) {
         for (int i = 0; i < (*header.std_opcode_lengths)[opcode]; i++) {
           size_t templen;
-          reader->ReadUnsignedLEB128(start, &templen);
+          reader->ReadUnsignedLEB128(start, end, &templen);
           start += templen;
           oplen += templen;
         }
@@ -1631,6 +2198,10 @@ void LineInfo::ReadLines() {
   else
     lengthstart += 4;
 
+  // Operands may be read ahead up to the end of the buffer, which is
+  // usually past the end of this line program.
+  const char* bufferend = buffer_ + buffer_length_;
+
   if (logicals_start_ != NULL && actuals_start_ != NULL) {
     // Two-level line table.
     LogicalsVector logicals;
@@ -1643,7 +2214,7 @@ void LineInfo::ReadLines() {
       while (!lsm.end_sequence && lineptr < actuals_start_) {
         size_t oplength;
         bool add_line = ProcessOneOpcode(reader_, handler_, header_,
-                                         lineptr, &lsm, &oplength,
+                                         lineptr, bufferend, &lsm, &oplength,
                                          &logicals, false);
         if (add_line) {
           logicals.push_back(lsm);
@@ -1665,7 +2236,7 @@ void LineInfo::ReadLines() {
       while (!lsm.end_sequence) {
         size_t oplength;
         bool add_line = ProcessOneOpcode(reader_, handler_, header_,
-                                         lineptr, &lsm, &oplength,
+                                         lineptr, bufferend, &lsm, &oplength,
                                          &logicals, true);
         if (add_line) {
           if (lsm.line_num >= 1
@@ -1696,10 +2267,18 @@ void LineInfo::ReadLines() {
     while (lineptr < lengthstart + header_.total_length) {
       lsm.Reset(header_.default_is_stmt);
       while (!lsm.end_sequence) {
+        // Special opcodes, which each add a line, are decoded right here.
+        const uint8 opcode = reader_->ReadOneByte(lineptr);
         size_t oplength;
-        bool add_line = ProcessOneOpcode(reader_, handler_, header_,
-                                         lineptr, &lsm, &oplength,
-                                         NULL, false);
+        bool add_line;
+        if (opcode >= header_.opcode_base) {
+          ProcessSpecialOpcode(header_, opcode, &lsm);
+          oplength = 1;
+          add_line = true;
+        } else {
+          add_line = ProcessOneOpcode(reader_, handler_, header_, lineptr,
+                                      bufferend, &lsm, &oplength, NULL, false);
+        }
         if (add_line) {
           handler_->AddLine(lsm.address, lsm.file_num, lsm.line_num,
                             lsm.column_num, lsm.discriminator,
@@ -101,17 +101,23 @@ class LineInfo {
   // Returns the number of bytes processed.
   uint64 Start();
 
-  // Process a single line info opcode at START using the state
-  // machine at LSM.  Return true if we should define a line using the
-  // current state of the line state machine.  Place the length of the
-  // opcode in LEN.
+  // Process a single line info opcode at START, in a buffer ending at
+  // END, using the state machine at LSM.  Return true if we should define
+  // a line using the current state of the line state machine.  Place the
+  // length of the opcode in LEN.
   static bool ProcessOneOpcode(
       ByteReader* reader, LineInfoHandler* handler,
       const struct LineInfoHeader& header, const char* start,
-      struct LineStateMachine* lsm, size_t* len,
+      const char* end, struct LineStateMachine* lsm, size_t* len,
       const std::vector<struct LineStateMachine>* logicals, bool is_actuals);
 
  private:
+  // Apply the special OPCODE, which is at least the opcode base, to the
+  // state machine at LSM.
+  static void ProcessSpecialOpcode(const struct LineInfoHeader& header,
+                                   uint8 opcode,
+                                   struct LineStateMachine* lsm);
+
   static const int VERSION_TWO_LEVEL = 0xf006;
 
   // Advance lineptr in a buffer.  If lineptr will advance beyond the
@@ -132,9 +138,18 @@ class LineInfo {
   // Reads a string of one of the forms DW_FORM_string or DW_FORM_line_strp.
   bool ReadStringForm(uint32 form, const char** dirname, const char** lineptr);
 
-  // Reads an unsigned integer of form DW_FORM_udata.
+  // Reads an unsigned integer of form DW_FORM_udata or DW_FORM_data1
+  // to DW_FORM_data8.
   bool ReadUnsignedForm(uint32 form, uint64* value, const char** lineptr);
 
+  // Skips a value of FORM, which is one of those above, DW_FORM_strp,
+  // DW_FORM_data16 or DW_FORM_block.
+  bool SkipForm(uint32 form, const char** lineptr);
+
+  // Reads a DWARF 5 directory table if DIRECTORIES, or else file name
+  // table, and defines its entries in the handler.
+  bool ReadEntryTable(bool directories, const char** lineptr);
+
   // Reads the DWARF2/3 header for this line info.
   void ReadHeader();
 
@@ -379,6 +394,13 @@ class Dwarf2Handler {
                                       enum DwarfForm form,
                                       const char* data) { }
 
+  // Called for a DIE at OFFSET with TAG that has children, once its
+  // attributes have been processed, or skipped if StartDIE returned
+  // false.  Return false if you would like to skip all of its
+  // children: none of them is then started or ended, and their
+  // attributes are not read.  EndDIE is still called for this DIE.
+  virtual bool WantChildren(uint64 offset, enum DwarfTag tag) { return true; }
+
   // Called when finished processing the DIE at OFFSET.
   // Because DWARF2/3 specifies a tree of DIEs, you may get starts
   // before ends of the previous DIE, as we process children before
@@ -424,6 +446,64 @@ class Dwarf2Handler {
 // -feliminate-dwarf2-dups.  Other toolchains will sometimes do
 // duplicate elimination in the linker.
 
+// This struct represents a single DWARF2/3 abbreviation
+// The abbreviation tells how to read a DWARF2/3 DIE, and consist of a
+// tag and a list of attributes, as well as the data form of each attribute.
+struct Abbrev {
+  uint32 number;
+  enum DwarfTag tag;
+  bool has_children;
+  AttributeList attributes;
+
+  // Values of the DW_FORM_implicit_const attributes, in the order of
+  // attributes.  Such values are in the abbreviation, not in the DIEs.
+  std::vector<int64> implicit_consts;
+
+  // Whether the attributes of a DIE have a size known from the
+  // abbreviation and the unit header alone, so that the DIE can be
+  // skipped without reading them.  That size is
+  //   fixed_size + num_addresses * address size + num_offsets * offset size
+  //   + num_ref_addrs * (address size in DWARF 2, offset size after).
+  bool has_fixed_size;
+  uint32 fixed_size;
+  uint16 num_addresses;
+  uint16 num_offsets;
+  uint16 num_ref_addrs;
+
+  // Index of the DW_AT_sibling attribute in attributes, or -1 if there is
+  // none.  It points past the children, so that they can be skipped at once.
+  int sibling_index;
+};
+
+// A set of DWARF2/3 abbreviations, indexed by abbreviation number, which
+// means that entry 0 is not valid.
+typedef std::vector<Abbrev> AbbrevTable;
+
+// Holds the abbreviation tables read by compilation units, keyed by their
+// start in .debug_abbrev, that is by abbrev offset.  Compilation units
+// share few tables, all of those of an LTO partition usually share one,
+// so a cache living as long as the sections is read by every unit and
+// parses each table once.  The tables do not change once added.  A cache
+// is not thread-safe: threads reading units concurrently each need their
+// own.
+class AbbrevTableCache {
+ public:
+  AbbrevTableCache() { }
+  ~AbbrevTableCache();
+
+  // Returns the table starting at ABBREV_START, or NULL if it has not
+  // been added.
+  const AbbrevTable* Find(const char* abbrev_start) const;
+
+  // Adds TABLE, which starts at ABBREV_START, and takes ownership of it.
+  // Returns TABLE.
+  const AbbrevTable* Add(const char* abbrev_start, AbbrevTable* table);
+
+ private:
+  map<const char*, AbbrevTable*> tables_;
+  DISALLOW_EVIL_CONSTRUCTORS(AbbrevTableCache);
+};
+
 class CompilationUnit {
  public:
   // Initialize a compilation unit.  This requires a map of sections,
@@ -448,6 +528,13 @@ class CompilationUnit {
   void SetSplitDwarf(const char* addr_buffer, uint64 addr_buffer_length,
                      uint64 addr_base, uint64 ranges_base, uint64 dwo_id);
 
+  // Use the abbreviation tables in ABBREV_CACHE, and add those read to it,
+  // instead of those of a cache owned by this unit.  ABBREV_CACHE must not
+  // outlive the sections of this unit.
+  void set_abbrev_cache(AbbrevTableCache* abbrev_cache) {
+    abbrev_cache_ = abbrev_cache;
+  }
+
   bool malformed() const {return malformed_;}
 
   // Begin reading a Dwarf2 compilation unit, and calling the
@@ -462,22 +549,13 @@ class CompilationUnit {
   uint64 Start(uint64 offset);
 
  private:
-  // This struct represents a single DWARF2/3 abbreviation
-  // The abbreviation tells how to read a DWARF2/3 DIE, and consist of a
-  // tag and a list of attributes, as well as the data form of each attribute.
-  struct Abbrev {
-    uint32 number;
-    enum DwarfTag tag;
-    bool has_children;
-    AttributeList attributes;
-  };
-
   // A DWARF2/3 compilation unit header.  This is not the same size as
   // in the actual file, as the one in the file may have a 32 bit or
   // 64 bit length.
   struct CompilationUnitHeader {
     uint64 length;
     uint16 version;
+    uint8 unit_type;
     uint64 abbrev_offset;
     uint8 address_size;
   } header_;
@@ -488,6 +566,24 @@ class CompilationUnit {
   // Reads the DWARF2/3 abbreviations for this compilation unit
   void ReadAbbrevs();
 
+  // Reads DW_AT_str_offsets_base, DW_AT_addr_base and DW_AT_rnglists_base
+  // of a DWARF 5 unit DIE.  Attributes before them in the unit DIE may be
+  // indexed through them, so they are read ahead of it.
+  void ReadUnitBases();
+
+  // Returns the string at INDEX in the string offsets table of this unit,
+  // or NULL if INDEX or the offset there is out of range.
+  const char* ReadIndexedString(uint64 index);
+
+  // Sets ADDRESS to the address at INDEX in the address table of this
+  // unit.  Returns false if INDEX is out of range.
+  bool ReadIndexedAddress(uint64 index, uint64* address);
+
+  // Sets OFFSET to the offset in .debug_rnglists of the range list at
+  // INDEX in the range list table of this unit.  Returns false if INDEX
+  // is out of range.
+  bool ReadRangeListOffset(uint64 index, uint64* offset);
+
   // Processes a single DIE for this compilation unit.
   //
   // Returns a new pointer just past the end of it, or NULL if a
@@ -496,7 +592,9 @@ class CompilationUnit {
                                   const char* start,
                                   const Abbrev& abbrev);
 
-  // Processes a single attribute.
+  // Processes a single attribute.  Strings, addresses and range lists
+  // referred to by index are looked up, DW_FORM_rnglistx being given to the
+  // handler as the offset of its range list in .debug_rnglists.
   //
   // Returns a new pointer just past the end of it, or NULL if malformed.
   const char* ProcessAttribute(uint64 dieoffset,
@@ -574,6 +672,17 @@ class CompilationUnit {
   // START, and return the new place to position the stream to.
   const char* SkipDIE(const char* start, const Abbrev& abbrev);
 
+  // Returns the DIE that DW_AT_sibling of the DIE with attributes specified
+  // in ABBREV starting at START points to, or NULL if it has none or does
+  // not point past START and before END, the end of this compilation unit.
+  const char* FindSibling(const char* start, const Abbrev& abbrev,
+                          const char* end);
+
+  // Skips all the children of a DIE, the first of which starts at START,
+  // and returns the new place to position the stream to, just past the
+  // null entry ending them.  END is the end of this compilation unit.
+  const char* SkipChildren(const char* start, const char* end);
+
   // Skips the attribute starting at START, with FORM, and return the
   // new place to position the stream to.
   const char* SkipAttribute(const char* start, enum DwarfForm form);
@@ -608,10 +717,14 @@ class CompilationUnit {
   // The associated handler to call processing functions in
   Dwarf2Handler* handler_;
 
-  // Set of DWARF2/3 abbreviations for this compilation unit.  Indexed
-  // by abbreviation number, which means that abbrevs_[0] is not
-  // valid.
-  std::vector<Abbrev>* abbrevs_;
+  // Set of DWARF2/3 abbreviations for this compilation unit, owned by
+  // abbrev_cache_.
+  const AbbrevTable* abbrevs_;
+
+  // Cache the abbreviation tables are read from, either own_abbrev_cache_
+  // or one shared by the compilation units of a file.
+  AbbrevTableCache own_abbrev_cache_;
+  AbbrevTableCache* abbrev_cache_;
 
   // String section buffer and length, if we have a string section.
   // This is here to avoid doing a section lookup for strings in
@@ -619,6 +732,11 @@ class CompilationUnit {
   const char* string_buffer_;
   uint64 string_buffer_length_;
 
+  // Line string section buffer and length, if we have a line string
+  // section (.debug_line_str), for DW_FORM_line_strp.
+  const char* line_string_buffer_;
+  uint64 line_string_buffer_length_;
+
   // String offsets section buffer and length, if we have a string offsets
   // section (.debug_str_offsets or .debug_str_offsets.dwo).
   const char* str_offsets_buffer_;
@@ -629,6 +747,11 @@ class CompilationUnit {
   const char* addr_buffer_;
   uint64 addr_buffer_length_;
 
+  // Range list section buffer and length, if we have a DWARF 5 range
+  // list section (.debug_rnglists).
+  const char* rnglists_buffer_;
+  uint64 rnglists_buffer_length_;
+
   // Flag indicating whether this compilation unit is part of a .dwo
   // or .dwp file.  If true, we are reading this unit because a
   // skeleton compilation unit in an executable file had a
@@ -651,9 +774,15 @@ class CompilationUnit {
   // The value of the DW_AT_GNU_ranges_base attribute, if any.
   uint64 ranges_base_;
 
-  // The value of the DW_AT_GNU_addr_base attribute, if any.
+  // The value of the DW_AT_GNU_addr_base or DW_AT_addr_base attribute,
+  // if any.
   uint64 addr_base_;
 
+  // The values of the DW_AT_str_offsets_base and DW_AT_rnglists_base
+  // attributes, if any.
+  uint64 str_offsets_base_;
+  uint64 rnglists_base_;
+
   // True if we have already looked for a .dwp file.
   bool have_checked_for_dwp_;
 
@@ -17,6 +17,7 @@
 #include "base/logging.h"
 #include "symbolize/bytereader.h"
 #include "symbolize/bytereader-inl.h"
+#include "symbolize/dwarf2enums.h"
 
 namespace devtools_crosstool_autofdo {
 
@@ -47,4 +48,82 @@ void AddressRangeList::ReadRangeList(uint64 offset, uint64 base,
   } while (true);
 }
 
+uint64 AddressRangeList::ReadIndexedAddress(uint64 addr_base,
+                                            uint64 index) {
+  const uint64 entry = addr_base + index * reader_->AddressSize();
+  CHECK(addr_buffer_ != NULL);
+  CHECK_LE(entry + reader_->AddressSize(), addr_buffer_length_);
+  return reader_->ReadAddress(addr_buffer_ + entry);
+}
+
+void AddressRangeList::ReadRngList(uint64 offset, uint64 base,
+                                   uint64 addr_base,
+                                   AddressRangeList::RangeList* ranges) {
+  CHECK(rnglists_buffer_ != NULL);
+  CHECK_LT(offset, rnglists_buffer_length_);
+  const char* pos = rnglists_buffer_ + offset;
+  const char* end = rnglists_buffer_ + rnglists_buffer_length_;
+  const uint8 width = reader_->AddressSize();
+  size_t len;
+  do {
+    CHECK_LT(pos, end);
+    const uint8 kind = reader_->ReadOneByte(pos);
+    pos += 1;
+    uint64 start, stop;
+    switch (kind) {
+      case DW_RLE_end_of_list:
+        return;
+      case DW_RLE_base_addressx:
+        base = ReadIndexedAddress(addr_base,
+                                  reader_->ReadUnsignedLEB128(pos, end, &len));
+        pos += len;
+        continue;
+      case DW_RLE_startx_endx:
+        start = ReadIndexedAddress(addr_base,
+                                   reader_->ReadUnsignedLEB128(pos, end, &len));
+        pos += len;
+        stop = ReadIndexedAddress(addr_base,
+                                  reader_->ReadUnsignedLEB128(pos, end, &len));
+        pos += len;
+        break;
+      case DW_RLE_startx_length:
+        start = ReadIndexedAddress(addr_base,
+                                   reader_->ReadUnsignedLEB128(pos, end, &len));
+        pos += len;
+        stop = start + reader_->ReadUnsignedLEB128(pos, end, &len);
+        pos += len;
+        break;
+      case DW_RLE_offset_pair:
+        start = base + reader_->ReadUnsignedLEB128(pos, end, &len);
+        pos += len;
+        stop = base + reader_->ReadUnsignedLEB128(pos, end, &len);
+        pos += len;
+        break;
+      case DW_RLE_base_address:
+        CHECK_LE(pos + width, end);
+        base = reader_->ReadAddress(pos);
+        pos += width;
+        continue;
+      case DW_RLE_start_end:
+        CHECK_LE(pos + 2*width, end);
+        start = reader_->ReadAddress(pos);
+        stop = reader_->ReadAddress(pos + width);
+        pos += 2*width;
+        break;
+      case DW_RLE_start_length:
+        CHECK_LE(pos + width, end);
+        start = reader_->ReadAddress(pos);
+        pos += width;
+        stop = start + reader_->ReadUnsignedLEB128(pos, end, &len);
+        pos += len;
+        break;
+      default:
+        LOG(WARNING) << "unknown range list entry kind " << int(kind)
+                     << " at offset " << (pos - 1 - rnglists_buffer_);
+        return;
+    }
+    ranges->push_back(make_pair(start, stop));
+  } while (true);
+}
+
 }  // namespace devtools_crosstool_autofdo
@@ -27,7 +27,9 @@ namespace devtools_crosstool_autofdo {
 // This class represents a DWARF3 non-contiguous address range.  The
 // contents of an address range section are passed in
 // (e.g. .debug_ranges) and subsequently, an interpretation of any
-// offset in the section can be requested.
+// offset in the section can be requested.  DWARF 5 range lists are
+// read from .debug_rnglists instead, with the addresses they refer to
+// by index in .debug_addr.
 class AddressRangeList {
  public:
   typedef pair<uint64, uint64> Range;
@@ -37,11 +39,37 @@ class AddressRangeList {
                    ByteReader* reader)
       : reader_(reader),
         buffer_(buffer),
-        buffer_length_(buffer_length) { }
+        buffer_length_(buffer_length),
+        rnglists_buffer_(NULL),
+        rnglists_buffer_length_(0),
+        addr_buffer_(NULL),
+        addr_buffer_length_(0) { }
+
+  AddressRangeList(const char* buffer,
+                   uint64 buffer_length,
+                   const char* rnglists_buffer,
+                   uint64 rnglists_buffer_length,
+                   const char* addr_buffer,
+                   uint64 addr_buffer_length,
+                   ByteReader* reader)
+      : reader_(reader),
+        buffer_(buffer),
+        buffer_length_(buffer_length),
+        rnglists_buffer_(rnglists_buffer),
+        rnglists_buffer_length_(rnglists_buffer_length),
+        addr_buffer_(addr_buffer),
+        addr_buffer_length_(addr_buffer_length) { }
 
   void ReadRangeList(uint64 offset, uint64 base,
                      RangeList* output);
 
+  // Reads the DWARF 5 range list at OFFSET in .debug_rnglists, for a
+  // compilation unit whose base address is BASE and whose addresses
+  // start at ADDR_BASE in .debug_addr.  Only the lists that are asked
+  // for are decoded.
+  void ReadRngList(uint64 offset, uint64 base, uint64 addr_base,
+                   RangeList* output);
+
   static uint64 RangesMin(const RangeList *ranges) {
     if (ranges->size() == 0)
       return 0;
@@ -59,9 +87,18 @@ class AddressRangeList {
   // The associated ByteReader that handles endianness issues for us
   ByteReader* reader_;
 
+  // Reads the address at INDEX of the table at ADDR_BASE in .debug_addr.
+  uint64 ReadIndexedAddress(uint64 addr_base, uint64 index);
+
   // buffer is the buffer for our range info
   const char* buffer_;
   uint64 buffer_length_;
+
+  // The .debug_rnglists and .debug_addr sections, for DWARF 5.
+  const char* rnglists_buffer_;
+  uint64 rnglists_buffer_length_;
+  const char* addr_buffer_;
+  uint64 addr_buffer_length_;
   DISALLOW_COPY_AND_ASSIGN(AddressRangeList);
 };
 
@@ -48,9 +48,12 @@
 #include <elf.h>
 #include <string.h>
 
+#include <zlib.h>
+
 #include <algorithm>
 #include <map>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 
 #include "symbolize/elf_reader.h"
@@ -83,6 +86,7 @@ class Elf32 {
   typedef Elf32_Phdr Phdr;
   typedef Elf32_Word Word;
   typedef Elf32_Sym Sym;
+  typedef Elf32_Chdr Chdr;
 
   // What should be in the EI_CLASS header.
   static const int kElfClass = ELFCLASS32;
@@ -105,6 +109,7 @@ class Elf64 {
   typedef Elf64_Phdr Phdr;
   typedef Elf64_Word Word;
   typedef Elf64_Sym Sym;
+  typedef Elf64_Chdr Chdr;
 
   // What should be in the EI_CLASS header.
   static const int kElfClass = ELFCLASS64;
@@ -130,7 +135,7 @@ class ElfSectionReader {
  public:
   ElfSectionReader(const string &path, int fd,
                    const typename ElfArch::Shdr &section_header)
-      : header_(section_header) {
+      : decompress_state_(kNotDecompressed), header_(section_header) {
     // Back up to the beginning of the page we're interested in.
     const size_t additional = header_.sh_offset % getpagesize();
     const size_t offset_aligned = header_.sh_offset - additional;
@@ -146,7 +151,78 @@ class ElfSectionReader {
   }
 
   ~ElfSectionReader() {
+    if (contents_aligned_ != NULL)
+      munmap(contents_aligned_, size_aligned_);
+  }
+
+  // Returns true if the section holds compressed data, either marked
+  // SHF_COMPRESSED or in the GNU .zdebug format (IS_ZDEBUG).
+  bool IsCompressed(bool is_zdebug) const {
+    if (header_.sh_flags & SHF_COMPRESSED)
+      return true;
+    return is_zdebug && section_size_ >= 12 &&
+           memcmp(contents_, "ZLIB", 4) == 0;
+  }
+
+  // Replaces the section contents by their decompressed form, if the
+  // section is compressed. The result is cached: only the first call
+  // does any work. Afterwards contents() and section_size() describe
+  // the decompressed data, and the file mapping is released. Returns
+  // false if the section could not be decompressed.
+  bool Decompress(bool is_zdebug) {
+    if (decompress_state_ != kNotDecompressed)
+      return decompress_state_ == kDecompressed;
+    decompress_state_ = kFailed;
+    if (!IsCompressed(is_zdebug)) {
+      decompress_state_ = kDecompressed;
+      return true;
+    }
+
+    const char *input;
+    size_t input_size;
+    uint64 output_size;
+    if (header_.sh_flags & SHF_COMPRESSED) {
+      typename ElfArch::Chdr chdr;
+      if (section_size_ < sizeof(chdr)) {
+        LOG(ERROR) << "Truncated compressed section header";
+        return false;
+      }
+      memcpy(&chdr, contents_, sizeof(chdr));
+      if (chdr.ch_type != ELFCOMPRESS_ZLIB) {
+        LOG(ERROR) << "Unsupported section compression type "
+                   << chdr.ch_type;
+        return false;
+      }
+      input = contents_ + sizeof(chdr);
+      input_size = section_size_ - sizeof(chdr);
+      output_size = chdr.ch_size;
+    } else {
+      // "ZLIB" followed by the uncompressed size as a big-endian
+      // 64-bit integer.
+      output_size = 0;
+      for (int i = 4; i < 12; ++i)
+        output_size = (output_size << 8) | static_cast<uint8>(contents_[i]);
+      input = contents_ + 12;
+      input_size = section_size_ - 12;
+    }
+
+    decompressed_.resize(output_size);
+    uLongf decompressed_size = output_size;
+    int ret = uncompress(reinterpret_cast<Bytef *>(decompressed_.data()),
+                         &decompressed_size,
+                         reinterpret_cast<const Bytef *>(input), input_size);
+    if (ret != Z_OK || decompressed_size != output_size) {
+      LOG(ERROR) << "Could not decompress section: zlib error " << ret;
+      vector<char>().swap(decompressed_);
+      return false;
+    }
+
     munmap(contents_aligned_, size_aligned_);
+    contents_aligned_ = NULL;
+    contents_ = decompressed_.data();
+    section_size_ = output_size;
+    decompress_state_ = kDecompressed;
+    return true;
   }
 
   // Return the section header for this section.
@@ -170,6 +246,9 @@ class ElfSectionReader {
   size_t size_aligned_;
   // size of contents.
   size_t section_size_;
+  // Decompressed contents, if the section was compressed.
+  vector<char> decompressed_;
+  enum { kNotDecompressed, kDecompressed, kFailed } decompress_state_;
   const typename ElfArch::Shdr header_;
 
   DISALLOW_EVIL_CONSTRUCTORS(ElfSectionReader);
@@ -343,6 +422,27 @@ class ElfReaderImpl {
     }
   }
 
+  void ForEachSymbol(
+      typename ElfArch::Word section_type,
+      const std::function<void(const ElfReader::SymbolView &)> &visitor) {
+    for (SymbolIterator<ElfArch> it(this, section_type);
+         !it.done(); it.Next()) {
+      const char *name = it.GetSymbolName();
+      if (!name) continue;
+      const typename ElfArch::Sym *sym = it.GetSymbol();
+      typename ElfArch::Sym symbol = *sym;
+      AdjustSymbolValue(&symbol);
+      ElfReader::SymbolView view;
+      view.name = absl::string_view(name);
+      view.address = symbol.st_value;
+      view.size = symbol.st_size;
+      view.binding = ElfArch::Bind(sym);
+      view.type = ElfArch::Type(sym);
+      view.section = sym->st_shndx;
+      visitor(view);
+    }
+  }
+
   // Return an ElfSectionReader for the first section of the given
   // type by iterating through all section headers. Returns NULL if
   // the section type is not found.
@@ -365,7 +465,7 @@ class ElfReaderImpl {
   // Return a pointer to section "shndx", and store the size in
   // "size".  Returns NULL if the section is not found.
   const char *GetSectionContentsByIndex(int shndx, size_t *size) {
-    const ElfSectionReader<ElfArch> *section = GetSection(shndx);
+    const ElfSectionReader<ElfArch> *section = GetDecompressedSection(shndx);
     if (section != NULL) {
       *size = section->section_size();
       return section->contents();
@@ -397,7 +497,8 @@ class ElfReaderImpl {
       int shndx = is_dwp_ ? GetNumSections() - k - 1 : k;
       const char *name = GetSectionName(section_headers_[shndx].sh_name);
       if (name != NULL && ElfReader::SectionNamesMatch(section_name, name)) {
-        const ElfSectionReader<ElfArch> *section = GetSection(shndx);
+        const ElfSectionReader<ElfArch> *section =
+            GetDecompressedSection(shndx);
         if (section == NULL) {
           return NULL;
         } else {
@@ -420,15 +521,16 @@ class ElfReaderImpl {
       int shndx = is_dwp_ ? GetNumSections() - k - 1 : k;
       const char *name = GetSectionName(section_headers_[shndx].sh_name);
       if (name != NULL && ElfReader::SectionNamesMatch(section_name, name)) {
-        const ElfSectionReader<ElfArch> *section = GetSection(shndx);
+        const ElfSectionReader<ElfArch> *section =
+            GetDecompressedSection(shndx);
         if (section == NULL) {
           return NULL;
         } else {
           info->type = section->header().sh_type;
-          info->flags = section->header().sh_flags;
+          info->flags = section->header().sh_flags & ~SHF_COMPRESSED;
           info->addr = section->header().sh_addr;
           info->offset = section->header().sh_offset;
-          info->size = section->header().sh_size;
+          info->size = section->section_size();
           info->link = section->header().sh_link;
           info->info = section->header().sh_info;
           info->addralign = section->header().sh_addralign;
@@ -466,7 +568,8 @@ class ElfReaderImpl {
     // direction of iteration.
     for (int k = GetNumSections() - 1; k >= 0; --k) {
       const char *name = GetSectionName(section_headers_[k].sh_name);
-      if (strncmp(name, ".debug", strlen(".debug")) == 0)
+      if (strncmp(name, ".debug", strlen(".debug")) == 0 ||
+          strncmp(name, ".zdebug", strlen(".zdebug")) == 0)
         return true;
     }
     return false;
@@ -476,6 +579,35 @@ class ElfReaderImpl {
     return header_.e_type == ET_DYN;
   }
 
+  bool IsRelocatableObject() const {
+    return header_.e_type == ET_REL;
+  }
+
+  // Return the number of sections.
+  int GetNumSections() const {
+    if (HasManySections())
+      return first_section_header_.sh_size;
+    return header_.e_shnum;
+  }
+
+  // Fill in "info" from the header of section "shndx". Returns false if
+  // the section is not found.
+  bool GetSectionInfoByIndex(int shndx, ElfReader::SectionInfo *info) const {
+    if (shndx < 0 || shndx >= GetNumSections())
+      return false;
+    const typename ElfArch::Shdr &header = section_headers_[shndx];
+    info->type = header.sh_type;
+    info->flags = header.sh_flags;
+    info->addr = header.sh_addr;
+    info->offset = header.sh_offset;
+    info->size = header.sh_size;
+    info->link = header.sh_link;
+    info->info = header.sh_info;
+    info->addralign = header.sh_addralign;
+    info->entsize = header.sh_entsize;
+    return true;
+  }
+
  private:
   typedef vector<pair<uint64, const typename ElfArch::Sym *> > AddrToSymMap;
 
@@ -502,13 +634,6 @@ class ElfReaderImpl {
     return header_.e_phnum;
   }
 
-  // Return the number of sections.
-  int GetNumSections() const {
-    if (HasManySections())
-      return first_section_header_.sh_size;
-    return header_.e_shnum;
-  }
-
   // Return the index of the string table.
   int GetStringTableIndex() const {
     if (HasManySections()) {
@@ -550,6 +675,72 @@ class ElfReaderImpl {
     return reader;
   }
 
+  // Returns true if section SHNDX holds debug info that may be
+  // compressed, and sets IS_ZDEBUG for the GNU .zdebug format.
+  bool IsDebugSection(int shndx, bool *is_zdebug) {
+    if (shndx == GetStringTableIndex())
+      return false;
+    const char *name = GetSectionNameByIndex(shndx);
+    if (name == NULL)
+      return false;
+    *is_zdebug = strncmp(name, ".zdebug", strlen(".zdebug")) == 0;
+    return *is_zdebug || strncmp(name, ".debug", strlen(".debug")) == 0;
+  }
+
+  // Like GetSection, but debug sections are decompressed on first use.
+  // Returns NULL if a compressed section is corrupt.
+  const ElfSectionReader<ElfArch> *GetDecompressedSection(int shndx) {
+    GetSection(shndx);
+    ElfSectionReader<ElfArch> *section = sections_[shndx];
+    bool is_zdebug = false;
+    if (section != NULL && IsDebugSection(shndx, &is_zdebug) &&
+        !section->Decompress(is_zdebug))
+      return NULL;
+    return section;
+  }
+
+ public:
+  // Decompresses the compressed debug sections named in SECTION_NAMES,
+  // one thread per section, so that later lookups find them cached.
+  void DecompressSections(const vector<string> &section_names) {
+    vector<pair<ElfSectionReader<ElfArch> *, bool> > compressed;
+    for (int shndx = 0; shndx < GetNumSections(); ++shndx) {
+      bool is_zdebug = false;
+      if (!IsDebugSection(shndx, &is_zdebug))
+        continue;
+      const char *name = GetSectionNameByIndex(shndx);
+      bool requested = false;
+      for (const string &section_name : section_names) {
+        if (ElfReader::SectionNamesMatch(section_name, name)) {
+          requested = true;
+          break;
+        }
+      }
+      if (!requested)
+        continue;
+      // Map the sections up front; only the decompression itself runs
+      // concurrently, and each thread touches a single section.
+      GetSection(shndx);
+      ElfSectionReader<ElfArch> *section = sections_[shndx];
+      if (section->IsCompressed(is_zdebug))
+        compressed.push_back(make_pair(section, is_zdebug));
+    }
+    if (compressed.size() <= 1) {
+      for (const auto &section : compressed)
+        section.first->Decompress(section.second);
+      return;
+    }
+    vector<std::thread> threads;
+    for (const auto &section : compressed) {
+      threads.emplace_back([section]() {
+        section.first->Decompress(section.second);
+      });
+    }
+    for (std::thread &thread : threads)
+      thread.join();
+  }
+
+ private:
   // Parse out the overall header information from the file and assert
   // that it looks sane. This contains information like the magic
   // number and target architecture.
@@ -669,7 +860,8 @@ class ElfReaderImpl {
 };
 
 ElfReader::ElfReader(const string &path)
-    : path_(path), fd_(-1), impl32_(NULL), impl64_(NULL) {
+    : path_(path), fd_(-1), impl32_(NULL), impl64_(NULL),
+      sorted_symbols_built_(false) {
   // linux 2.6.XX kernel can show deleted files like this:
   //   /var/run/nscd/dbYLJYaE (deleted)
   // and the kernel-supplied vdso and vsyscall mappings like this:
@@ -758,6 +950,31 @@ void ElfReader::VisitSymbols(ElfReader::SymbolSink *sink,
   }
 }
 
+void ElfReader::ForEachSymbol(
+    const std::function<void(const SymbolView &)> &visitor) {
+  if (IsElf32File()) {
+    GetImpl32()->ForEachSymbol(SHT_SYMTAB, visitor);
+    GetImpl32()->ForEachSymbol(SHT_DYNSYM, visitor);
+  } else if (IsElf64File()) {
+    GetImpl64()->ForEachSymbol(SHT_SYMTAB, visitor);
+    GetImpl64()->ForEachSymbol(SHT_DYNSYM, visitor);
+  }
+}
+
+const vector<ElfReader::SymbolView> &ElfReader::GetSortedSymbols() {
+  if (sorted_symbols_built_)
+    return sorted_symbols_;
+  sorted_symbols_built_ = true;
+  ForEachSymbol([this](const SymbolView &symbol) {
+    sorted_symbols_.push_back(symbol);
+  });
+  std::stable_sort(sorted_symbols_.begin(), sorted_symbols_.end(),
+                   [](const SymbolView &a, const SymbolView &b) {
+                     return a.address < b.address;
+                   });
+  return sorted_symbols_;
+}
+
 uint64 ElfReader::VaddrOfFirstLoadSegment() {
   if (IsElf32File()) {
     return GetImpl32()->VaddrOfFirstLoadSegment();
@@ -826,6 +1043,16 @@ const char *ElfReader::GetSectionInfoByName(const string &section_name,
   }
 }
 
+void ElfReader::DecompressSections(const vector<string> &section_names) {
+  if (IsElf32File()) {
+    GetImpl32()->DecompressSections(section_names);
+  } else if (IsElf64File()) {
+    GetImpl64()->DecompressSections(section_names);
+  } else {
+    LOG(ERROR) << "not an elf binary: " << path_;
+  }
+}
+
 bool ElfReader::SectionNamesMatch(const string &name, const string &sh_name) {
   if ((name.find(".debug_", 0) == 0) && (sh_name.find(".zdebug_", 0) == 0)) {
     const string name_suffix(name, strlen(".debug_"));
@@ -910,6 +1137,39 @@ bool ElfReader::IsDynamicSharedObject() {
   }
 }
 
+bool ElfReader::IsRelocatableObject() {
+  if (IsElf32File()) {
+    return GetImpl32()->IsRelocatableObject();
+  } else if (IsElf64File()) {
+    return GetImpl64()->IsRelocatableObject();
+  } else {
+    LOG(ERROR) << "not an elf binary: " << path_;
+    return false;
+  }
+}
+
+int ElfReader::GetNumSections() {
+  if (IsElf32File()) {
+    return GetImpl32()->GetNumSections();
+  } else if (IsElf64File()) {
+    return GetImpl64()->GetNumSections();
+  } else {
+    LOG(ERROR) << "not an elf binary: " << path_;
+    return 0;
+  }
+}
+
+bool ElfReader::GetSectionInfoByIndex(int shndx, SectionInfo *info) {
+  if (IsElf32File()) {
+    return GetImpl32()->GetSectionInfoByIndex(shndx, info);
+  } else if (IsElf64File()) {
+    return GetImpl64()->GetSectionInfoByIndex(shndx, info);
+  } else {
+    LOG(ERROR) << "not an elf binary: " << path_;
+    return false;
+  }
+}
+
 ElfReaderImpl<Elf32> *ElfReader::GetImpl32() {
   if (impl32_ == NULL) {
     impl32_ = new ElfReaderImpl<Elf32>(path_, fd_);
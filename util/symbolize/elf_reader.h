@@ -27,7 +27,9 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 #include "base/common.h"
+#include "third_party/abseil/absl/strings/string_view.h"
 
 namespace devtools_crosstool_autofdo {
 
@@ -55,6 +57,10 @@ class ElfReader {
   // Checks if it's an ELF file of type ET_DYN (shared object file).
   bool IsDynamicSharedObject();
 
+  // Checks if it's an ELF file of type ET_REL (relocatable object file),
+  // such as a Linux kernel module.
+  bool IsRelocatableObject();
+
   class SymbolSink {
    public:
     virtual ~SymbolSink() {}
@@ -81,6 +87,28 @@ class ElfReader {
   void VisitSymbols(SymbolSink *sink, int symbol_binding, int symbol_type,
                     bool get_raw_symbol_values);
 
+  // A symbol table entry whose name points into the mmapped string
+  // table, so it can be passed around without copying the name.
+  struct SymbolView {
+    absl::string_view name;
+    uint64 address;
+    uint64 size;
+    int binding;
+    int type;
+    int section;
+  };
+
+  // Calls "visitor" on each named symbol of any SHT_SYMTAB section,
+  // followed by any SHT_DYNSYM section, with adjusted symbol values. The
+  // names are only valid until the ElfReader gets destroyed.
+  void ForEachSymbol(const std::function<void(const SymbolView &)> &visitor);
+
+  // Returns the symbols visited by ForEachSymbol, sorted by address.
+  // Symbols at the same address keep their order in the file, .symtab
+  // first. The array is built on the first call and shared by all later
+  // callers; it is only valid until the ElfReader gets destroyed.
+  const vector<SymbolView> &GetSortedSymbols();
+
   // p_vaddr of the first PT_LOAD segment (if any), or 0 if no PT_LOAD
   // segments are present. This is the address an ELF image was linked
   // (by static linker) to be loaded at. Usually (but not always) 0 for
@@ -108,6 +136,12 @@ class ElfReader {
   // destroyed.
   const char *GetSectionByName(const string &section_name, size_t *size);
 
+  // Compressed debug sections (SHF_COMPRESSED or .zdebug_*) are
+  // decompressed transparently by the getters above, the first time they
+  // are requested. This decompresses the named sections ahead of time, in
+  // parallel.
+  void DecompressSections(const vector<string> &section_names);
+
   // Gets the buildid of the binary.
   string GetBuildId();
 
@@ -130,6 +164,13 @@ class ElfReader {
   const char *GetSectionInfoByName(const string &section_name,
                                    SectionInfo *info);
 
+  // Returns the number of sections, or 0 if this is not an ELF file.
+  int GetNumSections();
+
+  // Stores the header of section "shndx" in "info", without reading the
+  // section. Returns false if there is no such section.
+  bool GetSectionInfoByIndex(int shndx, SectionInfo *info);
+
   // Check if "path" is an ELF binary that has not been stripped of symbol
   // tables.  This function supports both 32-bit and 64-bit ELF binaries.
   static bool IsNonStrippedELFBinary(const string &path);
@@ -158,6 +199,9 @@ class ElfReader {
   int fd_;
   ElfReaderImpl<Elf32> *impl32_;
   ElfReaderImpl<Elf64> *impl64_;
+  // Cache for GetSortedSymbols().
+  vector<SymbolView> sorted_symbols_;
+  bool sorted_symbols_built_;
 
   DISALLOW_COPY_AND_ASSIGN(ElfReader);
 };
@@ -21,9 +21,11 @@
 #ifndef AUTOFDO_SYMBOLIZE_FUNCTIONINFO_H__
 #define AUTOFDO_SYMBOLIZE_FUNCTIONINFO_H__
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "base/common.h"
 #include "symbolize/bytereader.h"
@@ -72,6 +74,10 @@ struct LineIdentifier {
 // inline call stack, the context field from LineIdentifier
 // can be used to fetch the logical row for the calling
 // context.
+//
+// Address entries are appended unsorted while the line tables are
+// read; Freeze() must be called once all CUs are processed, before
+// any lookup. It sorts the entries into a contiguous array.
 class AddressToLineMap {
  public:
   // A vector containing Subprogram entries.
@@ -82,13 +88,14 @@ class AddressToLineMap {
   };
   typedef std::vector<struct SubprogInfo> SubprogVector;
 
-  // Map an address to a logical row number.
-  typedef std::map<uint64_t, uint32_t> AddressToLogical;
+  // Map an address to a logical row number, sorted by address once
+  // frozen.
+  typedef std::vector<std::pair<uint64_t, uint32_t> > AddressToLogical;
   typedef AddressToLogical::const_iterator const_iterator;
 
   AddressToLineMap()
     : subprogs_(), logical_lines_(), line_map_(), logical_map_(),
-      subprog_bias_(0) { }
+      subprog_bias_(0), frozen_(false) { }
 
   void StartCU() {
     subprog_bias_ = subprogs_.size();
@@ -105,7 +112,7 @@ class AddressToLineMap {
   // Adds both a logical entry and an actual entry.
   void AddLine(uint64 addr, LineIdentifier line_id) {
     logical_lines_.push_back(line_id);
-    line_map_[addr] = logical_lines_.size();
+    AddActual(addr, logical_lines_.size());
   }
 
   // Resize the per-CU logical map to the size of the CU's
@@ -144,10 +151,62 @@ class AddressToLineMap {
   }
 
   void AddActual(uint64 addr, uint64 logical_num) {
-    line_map_[addr] = logical_num;
+    DCHECK(!frozen_);
+    line_map_.push_back(std::make_pair(addr, logical_num));
+  }
+
+  // Moves all entries of OTHER, which was filled independently, to
+  // the end of this map, renumbering its logical and subprogram
+  // indices. Neither map may be frozen.
+  void Append(AddressToLineMap *other) {
+    CHECK(!frozen_);
+    CHECK(!other->frozen_);
+    const uint32 logical_bias = logical_lines_.size();
+    const uint32 subprog_bias = subprogs_.size();
+    subprogs_.insert(subprogs_.end(), other->subprogs_.begin(),
+                     other->subprogs_.end());
+    logical_lines_.reserve(logical_lines_.size() +
+                           other->logical_lines_.size());
+    for (LineIdentifier line_id : other->logical_lines_) {
+      if (line_id.context > 0) line_id.context += logical_bias;
+      if (line_id.subprog_num > 0) line_id.subprog_num += subprog_bias;
+      logical_lines_.push_back(line_id);
+    }
+    line_map_.reserve(line_map_.size() + other->line_map_.size());
+    for (const auto &addr_logical : other->line_map_) {
+      uint32 logical_num = addr_logical.second;
+      if (logical_num > 0) logical_num += logical_bias;
+      line_map_.push_back(std::make_pair(addr_logical.first, logical_num));
+    }
+    AddressToLogical().swap(other->line_map_);
+    std::vector<LineIdentifier>().swap(other->logical_lines_);
+    SubprogVector().swap(other->subprogs_);
+  }
+
+  // Sorts the address entries. If an address was added more than
+  // once, the last entry wins.
+  void Freeze() {
+    CHECK(!frozen_);
+    std::stable_sort(line_map_.begin(), line_map_.end(),
+                     [](const AddressToLogical::value_type &a,
+                        const AddressToLogical::value_type &b) {
+                       return a.first < b.first;
+                     });
+    AddressToLogical::iterator out = line_map_.begin();
+    for (AddressToLogical::iterator in = line_map_.begin();
+         in != line_map_.end(); ++in) {
+      AddressToLogical::iterator next = in + 1;
+      if (next != line_map_.end() && next->first == in->first)
+        continue;
+      *out++ = *in;
+    }
+    line_map_.erase(out, line_map_.end());
+    line_map_.shrink_to_fit();
+    frozen_ = true;
   }
 
   const_iterator begin() const {
+    DCHECK(frozen_);
     return line_map_.begin();
   }
 
@@ -156,7 +215,12 @@ class AddressToLineMap {
   }
 
   const_iterator upper_bound(uint64 addr) const {
-    return line_map_.upper_bound(addr);
+    DCHECK(frozen_);
+    return std::upper_bound(
+        line_map_.begin(), line_map_.end(), addr,
+        [](uint64 a, const AddressToLogical::value_type &b) {
+          return a < b.first;
+        });
   }
 
   const LineIdentifier& GetLogical(uint32 logical_num) const {
@@ -187,6 +251,9 @@ class AddressToLineMap {
   // to keep track of the first subprogram for the current CU, and adjust
   // all references into these arrays by this amount.
   uint32 subprog_bias_;
+
+  // True once Freeze() has sorted line_map_.
+  bool frozen_;
 };
 
 static int strcmp_maybe_null(const char *a, const char *b) {
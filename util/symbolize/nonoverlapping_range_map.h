@@ -55,41 +55,61 @@ struct RangeStartLt {
 // identical to the following three inserts: [0,5), [7,10), [12,15).
 // This convenience behavior is useful when inserting data for
 // hierarchical structures in bottom-up order.
+//
+// The map is built in a std::map and then frozen with Freeze(), which
+// moves the ranges into a sorted vector. Lookups and iteration are only
+// valid on a frozen map, and no ranges may be inserted after freezing.
 template<typename T>
 class NonOverlappingRangeMap {
  public:
   typedef map<AddressRangeList::Range, T, RangeStartLt> RangeMap;
-  typedef typename RangeMap::iterator Iterator;
-  typedef typename RangeMap::const_iterator ConstIterator;
+  typedef vector<pair<AddressRangeList::Range, T> > RangeVector;
+  typedef typename RangeVector::iterator Iterator;
+  typedef typename RangeVector::const_iterator ConstIterator;
 
   NonOverlappingRangeMap();
 
   void InsertRangeList(const AddressRangeList::RangeList& range_list,
                            const T& value);
   void InsertRange(uint64 low, uint64 high, const T& value);
+
+  // Converts the map into its compact, read-only form.
+  void Freeze();
+  bool frozen() const { return frozen_; }
+
   Iterator Find(uint64 address);
   ConstIterator Find(uint64 address) const;
 
+  // Returns the first address above ADDRESS at which Find may return
+  // another range: the end of the range containing ADDRESS, else the start
+  // of the next range, or ~0 if there is none.
+  uint64 NextBoundary(uint64 address) const;
+
   Iterator Begin();
   ConstIterator Begin() const;
   Iterator End();
   ConstIterator End() const;
 
-  bool Empty() const { return ranges_.empty(); }
+  bool Empty() const { return ranges_.empty() && frozen_ranges_.empty(); }
 
  private:
+  // Ranges being inserted, before Freeze().
   RangeMap ranges_;
+  // Ranges sorted by start address, after Freeze().
+  RangeVector frozen_ranges_;
+  bool frozen_;
   template<class IteratorType>
-  IteratorType FindHelper(uint64 address, IteratorType iter,
+  IteratorType FindHelper(uint64 address, IteratorType begin,
                           IteratorType end) const;
   bool RangeStrictlyContains(const AddressRangeList::Range& outer,
                              const AddressRangeList::Range& inner);
-  void SplitRange(Iterator split, uint64 low, uint64 high, const T& value);
+  void SplitRange(typename RangeMap::iterator split, uint64 low, uint64 high,
+                  const T& value);
   DISALLOW_COPY_AND_ASSIGN(NonOverlappingRangeMap);
 };
 
 template<class T>
-NonOverlappingRangeMap<T>::NonOverlappingRangeMap() { }
+NonOverlappingRangeMap<T>::NonOverlappingRangeMap() : frozen_(false) { }
 
 template<class T>
 void NonOverlappingRangeMap<T>::InsertRangeList(
@@ -104,13 +124,15 @@ void NonOverlappingRangeMap<T>::InsertRangeList(
 template<class T>
 void NonOverlappingRangeMap<T>::InsertRange(uint64 low, uint64 high,
                                             const T& value) {
+  CHECK(!frozen_);
   if (low == high)
     return;
 
-  Iterator insert_point = ranges_.lower_bound(make_pair(low, high));
+  typename RangeMap::iterator insert_point =
+      ranges_.lower_bound(make_pair(low, high));
 
   if (insert_point != ranges_.begin()) {
-    Iterator predecessor = insert_point;
+    typename RangeMap::iterator predecessor = insert_point;
     --predecessor;
 
     if (RangeStrictlyContains(predecessor->first, make_pair(low, high))) {
@@ -141,7 +163,7 @@ void NonOverlappingRangeMap<T>::InsertRange(uint64 low, uint64 high,
         // Ensure that insert does not end in the middle of another range
         CHECK(to == high || high >= insert_point->first.second);
         CHECK(from < to);
-        pair<Iterator, bool> insert_status =
+        pair<typename RangeMap::iterator, bool> insert_status =
             ranges_.insert(make_pair(make_pair(from, to), value));
         CHECK(insert_status.second);
       }
@@ -151,32 +173,57 @@ void NonOverlappingRangeMap<T>::InsertRange(uint64 low, uint64 high,
   }
 }
 
+template<class T>
+void NonOverlappingRangeMap<T>::Freeze() {
+  CHECK(!frozen_);
+  frozen_ranges_.assign(ranges_.begin(), ranges_.end());
+  RangeMap().swap(ranges_);
+  frozen_ = true;
+}
+
 template<class T>
 typename NonOverlappingRangeMap<T>::Iterator
 NonOverlappingRangeMap<T>::Find(uint64 address) {
-  AddressRangeList::Range singleton_range = make_pair(address, address + 1);
-  Iterator iter = ranges_.lower_bound(singleton_range);
-  return FindHelper(address, iter, ranges_.end());
+  return FindHelper(address, frozen_ranges_.begin(), frozen_ranges_.end());
 }
 
 template<class T>
 typename NonOverlappingRangeMap<T>::ConstIterator
 NonOverlappingRangeMap<T>::Find(uint64 address) const {
-  AddressRangeList::Range singleton_range = make_pair(address, address + 1);
-  ConstIterator iter = ranges_.lower_bound(singleton_range);
-  return FindHelper(address, iter, ranges_.end());
+  return FindHelper(address, frozen_ranges_.begin(), frozen_ranges_.end());
+}
+
+template<class T>
+uint64 NonOverlappingRangeMap<T>::NextBoundary(uint64 address) const {
+  DCHECK(frozen_);
+  ConstIterator iter = upper_bound(
+      frozen_ranges_.begin(), frozen_ranges_.end(), address,
+      [](uint64 addr, const typename RangeVector::value_type& range) {
+        return addr < range.first.first;
+      });
+  if (iter != frozen_ranges_.begin()) {
+    ConstIterator previous = iter - 1;
+    if (previous->first.second > address)
+      return previous->first.second;
+  }
+  return iter == frozen_ranges_.end() ? ~0ULL : iter->first.first;
 }
 
 template<class T>
 template<class IteratorType>
 IteratorType NonOverlappingRangeMap<T>::FindHelper(uint64 address,
-                                                   IteratorType iter,
+                                                   IteratorType begin,
                                                    IteratorType end) const {
-  if (iter == end || iter->first.first != address) {
-    if (iter == ranges_.begin())
-      return end;
-    --iter;
-  }
+  DCHECK(frozen_);
+  // Find the last range starting at or before ADDRESS.
+  IteratorType iter = upper_bound(
+      begin, end, address,
+      [](uint64 addr, const typename RangeVector::value_type& range) {
+        return addr < range.first.first;
+      });
+  if (iter == begin)
+    return end;
+  --iter;
 
   if (iter->first.second > address)
     return iter;
@@ -186,25 +233,27 @@ IteratorType NonOverlappingRangeMap<T>::FindHelper(uint64 address,
 template<class T>
 typename NonOverlappingRangeMap<T>::Iterator
 NonOverlappingRangeMap<T>::Begin() {
-  return ranges_.begin();
+  DCHECK(frozen_);
+  return frozen_ranges_.begin();
 }
 
 template<class T>
 typename NonOverlappingRangeMap<T>::ConstIterator
 NonOverlappingRangeMap<T>::Begin() const {
-  return ranges_.begin();
+  DCHECK(frozen_);
+  return frozen_ranges_.begin();
 }
 
 template<class T>
 typename NonOverlappingRangeMap<T>::Iterator
 NonOverlappingRangeMap<T>::End() {
-  return ranges_.end();
+  return frozen_ranges_.end();
 }
 
 template<class T>
 typename NonOverlappingRangeMap<T>::ConstIterator
 NonOverlappingRangeMap<T>::End() const {
-  return ranges_.end();
+  return frozen_ranges_.end();
 }
 
 template<class T>
@@ -216,11 +265,12 @@ bool NonOverlappingRangeMap<T>::RangeStrictlyContains(
 }
 
 template<class T>
-void NonOverlappingRangeMap<T>::SplitRange(Iterator split, uint64 low,
+void NonOverlappingRangeMap<T>::SplitRange(typename RangeMap::iterator split,
+                                           uint64 low,
                                            uint64 high, const T& value) {
   const AddressRangeList::Range old_range = split->first;
   const T old_value = split->second;
-  pair<Iterator, bool> insert_status;
+  pair<typename RangeMap::iterator, bool> insert_status;
 
   ranges_.erase(split);
 